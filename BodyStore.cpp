@@ -0,0 +1,147 @@
+#include "precompiled.h"
+
+BodyStore::BodyStore()
+    : bodyPool(sizeof(Body)), shapePool(MaxShapeSize)
+{
+}
+
+BodyStore::~BodyStore()
+{
+    Clear();
+}
+
+Body *BodyStore::Add(Shape *shape, int x, int y)
+{
+    int slot = records.size();
+    position.push_back(Vec(0, 0));
+    velocity.push_back(Vec(0, 0));
+    force.push_back(Vec(0, 0));
+    rotation.push_back(Rotor(1, 0));
+    angularVelocity.push_back(0);
+    torque.push_back(0);
+    AABB box = {Vec(0, 0), Vec(0, 0)}; // Set by the body's UpdateGeometry
+    bounds.push_back(box);
+
+    Shape *copy = shape->Clone(shapePool.Allocate());
+    Body *b = new (bodyPool.Allocate()) Body(this, slot, copy, x, y);
+    records.push_back(b);
+    im.push_back(b->im);
+    iI.push_back(b->iI);
+    previousPosition.push_back(position[slot]);
+    previousRotation.push_back(rotation[slot]);
+
+    int handle;
+    if (m_freeHandles.empty())
+    {
+        handle = m_slotOf.size();
+        m_slotOf.push_back(slot);
+        m_generations.push_back(0);
+    }
+    else
+    {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_slotOf[handle] = slot;
+    }
+    m_handleOf.push_back(handle);
+    return b;
+}
+
+Body *BodyStore::Get(BodyHandle h) const
+{
+    if (h.index < 0 || h.index >= m_slotOf.size() || m_generations[h.index] != h.generation)
+        return NULL;
+    int slot = m_slotOf[h.index];
+    return slot < 0 ? NULL : records[slot];
+}
+
+BodyHandle BodyStore::GetHandle(const Body *b) const
+{
+    int handle = m_handleOf[b->slot];
+    BodyHandle h = {handle, m_generations[handle]};
+    return h;
+}
+
+void BodyStore::Remove(Body *b)
+{
+    int slot = b->slot;
+    int last = records.size() - 1;
+    int handle = m_handleOf[slot];
+    m_slotOf[handle] = -1;
+    ++m_generations[handle];
+    m_freeHandles.push_back(handle);
+
+    if (slot != last)
+    {
+        Body *moved = records[last];
+        moved->slot = slot;
+        records[slot] = moved;
+        position[slot] = position[last];
+        velocity[slot] = velocity[last];
+        force[slot] = force[last];
+        rotation[slot] = rotation[last];
+        angularVelocity[slot] = angularVelocity[last];
+        torque[slot] = torque[last];
+        im[slot] = im[last];
+        iI[slot] = iI[last];
+        bounds[slot] = bounds[last];
+        previousPosition[slot] = previousPosition[last];
+        previousRotation[slot] = previousRotation[last];
+        m_handleOf[slot] = m_handleOf[last];
+        m_slotOf[m_handleOf[slot]] = slot;
+    }
+
+    records.pop_back();
+    position.pop_back();
+    velocity.pop_back();
+    force.pop_back();
+    rotation.pop_back();
+    angularVelocity.pop_back();
+    torque.pop_back();
+    im.pop_back();
+    iI.pop_back();
+    bounds.pop_back();
+    previousPosition.pop_back();
+    previousRotation.pop_back();
+    m_handleOf.pop_back();
+
+    Shape *shape = b->shape;
+    shape->Destroy();
+    shapePool.Free(shape);
+    b->~Body();
+    bodyPool.Free(b);
+}
+
+void BodyStore::Clear(void)
+{
+    for (int i = 0; i < records.size(); ++i)
+    {
+        records[i]->shape->Destroy();
+        records[i]->~Body();
+    }
+    shapePool.Clear();
+    bodyPool.Clear();
+
+    // Outstanding handles must stay stale once their entries are reused
+    for (int i = 0; i < m_handleOf.size(); ++i)
+    {
+        int handle = m_handleOf[i];
+        m_slotOf[handle] = -1;
+        ++m_generations[handle];
+        m_freeHandles.push_back(handle);
+    }
+
+    records.clear();
+    position.clear();
+    velocity.clear();
+    force.clear();
+    rotation.clear();
+    angularVelocity.clear();
+    torque.clear();
+    im.clear();
+    iI.clear();
+    bounds.clear();
+    previousPosition.clear();
+    previousRotation.clear();
+    m_handleOf.clear();
+}
@@ -0,0 +1,73 @@
+#ifndef BODYSTORE_H
+#define BODYSTORE_H
+
+#include "precompiled.h"
+
+struct Body;
+struct Shape;
+
+// Names a body without pointing at it. A handle whose body was removed, or
+// whose slot was reused since, resolves to NULL.
+struct BodyHandle
+{
+    int index;           // Into the store's handle table
+    unsigned generation; // Bumped every time the entry is released
+
+    bool IsNull(void) const { return index < 0; }
+};
+
+const BodyHandle nullBody = {-1, 0};
+
+// Owns a scene's bodies. The state every step reads and writes is kept in
+// dense structure of arrays, one entry per body by Body::slot, so the
+// integration, solver and broadphase loops walk memory in order. Shapes,
+// materials and colors stay on the Body record, which is allocated together
+// with its copy of the shape from the store's pools.
+struct BodyStore
+{
+    BodyStore();
+    ~BodyStore();
+
+    // Creates a body holding a copy of shape
+    Body *Add(Shape *shape, int x, int y);
+
+    // The last body takes over b's slot, every other slot stays put.
+    // b's handle goes stale.
+    void Remove(Body *b);
+
+    // Removes every body at once
+    void Clear(void);
+
+    // NULL once h's body is gone
+    Body *Get(BodyHandle h) const;
+    BodyHandle GetHandle(const Body *b) const;
+
+    int Count(void) const { return records.size(); }
+
+    // Dense by Body::slot
+    std::vector<Body *> records;
+    std::vector<Vec> position;
+    std::vector<Vec> velocity;
+    std::vector<Vec> force;
+    std::vector<Rotor> rotation;
+    std::vector<Real> angularVelocity;
+    std::vector<Real> torque;
+    std::vector<Real> im; // Copies of Body::im and Body::iI
+    std::vector<Real> iI;
+    std::vector<AABB> bounds; // World space, cached by Shape::UpdateGeometry
+
+    // Transforms before the last step, for Scene::Render to blend from
+    std::vector<Vec> previousPosition;
+    std::vector<Rotor> previousRotation;
+
+    Pool bodyPool;  // Body records
+    Pool shapePool; // Shapes, MaxShapeSize blocks
+
+private:
+    std::vector<int> m_handleOf;         // Handle entry per slot
+    std::vector<int> m_slotOf;           // Slot per handle entry, -1 while free
+    std::vector<unsigned> m_generations; // Per handle entry
+    std::vector<int> m_freeHandles;
+};
+
+#endif // BODYSTORE_H
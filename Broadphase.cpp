@@ -0,0 +1,410 @@
+#include "precompiled.h"
+
+static bool BothStatic(const Body *A, const Body *B)
+{
+    return A->im == 0 && B->im == 0;
+}
+
+BodyPair MakePair(Body *a, Body *b)
+{
+    BodyPair p;
+    p.A = a->id < b->id ? a : b;
+    p.B = a->id < b->id ? b : a;
+    return p;
+}
+
+void AllPairsBroadphase::FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs)
+{
+    pairs.clear();
+    for (int i = 0; i < bodies.size(); ++i)
+    {
+        Body *A = bodies[i];
+
+        for (int j = i + 1; j < bodies.size(); ++j)
+        {
+            Body *B = bodies[j];
+            if (BothStatic(A, B))
+                continue;
+            pairs.push_back(MakePair(A, B));
+        }
+    }
+}
+
+// Spread cell coordinates over the table, see "Optimized Spatial Hashing
+// for Collision Detection of Deformable Objects" (Teschner et al.)
+static unsigned HashCell(int x, int y)
+{
+    return (unsigned)x * 73856093u ^ (unsigned)y * 19349663u;
+}
+
+void HashGridBroadphase::FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs)
+{
+    const Real invCellSize = 1.0 / m_cellSize;
+
+    m_aabbs.resize(bodies.size());
+    m_entries.clear();
+    m_oversized.clear();
+    m_pairs.clear();
+
+    // Enter every body into the cells its bounds cover
+    for (int i = 0; i < bodies.size(); ++i)
+    {
+        AABB &box = m_aabbs[i];
+        box = bodies[i]->Bounds();
+
+        int x0 = (int)std::floor(box.min.x * invCellSize);
+        int y0 = (int)std::floor(box.min.y * invCellSize);
+        int x1 = (int)std::floor(box.max.x * invCellSize);
+        int y1 = (int)std::floor(box.max.y * invCellSize);
+
+        if ((long long)(x1 - x0 + 1) * (y1 - y0 + 1) > MaxCellsPerBody)
+        {
+            m_oversized.push_back(i);
+            continue;
+        }
+
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+            {
+                Entry e;
+                e.cell = HashCell(x, y);
+                e.body = i;
+                m_entries.push_back(e);
+            }
+    }
+
+    // Bodies sharing a hash bucket are candidates. Different cells may collide
+    // in the hash, the AABB test filters those out.
+    std::sort(m_entries.begin(), m_entries.end());
+    for (int first = 0; first < m_entries.size();)
+    {
+        int last = first + 1;
+        while (last < m_entries.size() && m_entries[last].cell == m_entries[first].cell)
+            ++last;
+
+        for (int i = first; i < last; ++i)
+            for (int j = i + 1; j < last; ++j)
+            {
+                int a = m_entries[i].body;
+                int b = m_entries[j].body;
+                if (BothStatic(bodies[a], bodies[b]) || !m_aabbs[a].Overlaps(m_aabbs[b]))
+                    continue;
+                m_pairs.push_back(std::make_pair(a, b));
+            }
+
+        first = last;
+    }
+
+    // Oversized bodies skip the grid and are checked against every body
+    for (int k = 0; k < m_oversized.size(); ++k)
+    {
+        int a = m_oversized[k];
+        for (int b = 0; b < bodies.size(); ++b)
+        {
+            if (a == b || BothStatic(bodies[a], bodies[b]) || !m_aabbs[a].Overlaps(m_aabbs[b]))
+                continue;
+
+            // Two oversized bodies would otherwise be reported twice
+            if (b < a && std::binary_search(m_oversized.begin(), m_oversized.end(), b))
+                continue;
+
+            m_pairs.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+    }
+
+    // A pair sharing several cells is found once per cell
+    std::sort(m_pairs.begin(), m_pairs.end());
+    m_pairs.erase(std::unique(m_pairs.begin(), m_pairs.end()), m_pairs.end());
+
+    pairs.clear();
+    for (int i = 0; i < m_pairs.size(); ++i)
+        pairs.push_back(MakePair(bodies[m_pairs[i].first], bodies[m_pairs[i].second]));
+}
+
+bool PairLess(const BodyPair &a, const BodyPair &b)
+{
+    return a.A->id < b.A->id || (a.A->id == b.A->id && a.B->id < b.B->id);
+}
+
+static bool PairEqual(const BodyPair &a, const BodyPair &b)
+{
+    return a.A == b.A && a.B == b.B;
+}
+
+AABB TreeBroadphase::FatAABB(Body *b) const
+{
+    AABB box = b->Bounds();
+    box.min -= Vec(m_margin, m_margin);
+    box.max += Vec(m_margin, m_margin);
+    return box;
+}
+
+void TreeBroadphase::Insert(Body *b)
+{
+    b->proxyId = tree.CreateProxy(FatAABB(b), b);
+    m_moved.push_back(b->proxyId);
+}
+
+void TreeBroadphase::Remove(Body *b)
+{
+    m_moved.erase(std::remove(m_moved.begin(), m_moved.end(), b->proxyId), m_moved.end());
+    tree.DestroyProxy(b->proxyId);
+    b->proxyId = -1;
+
+    int count = 0;
+    for (int i = 0; i < m_pairs.size(); ++i)
+        if (m_pairs[i].A != b && m_pairs[i].B != b)
+            m_pairs[count++] = m_pairs[i];
+    m_pairs.resize(count);
+}
+
+void TreeBroadphase::Clear(void)
+{
+    tree = DynamicTree();
+    m_moved.clear();
+    m_pairs.clear();
+}
+
+void TreeBroadphase::FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs)
+{
+    // Reinsert bodies that escaped their fat box
+    for (int i = 0; i < bodies.size(); ++i)
+    {
+        Body *b = bodies[i];
+        if (tree.GetAABB(b->proxyId).Contains(b->Bounds()))
+            continue;
+
+        tree.MoveProxy(b->proxyId, FatAABB(b));
+        m_moved.push_back(b->proxyId);
+    }
+    movedCount = m_moved.size();
+
+    // Only proxies that moved can have gained a pair
+    m_newPairs.clear();
+    for (int i = 0; i < m_moved.size(); ++i)
+    {
+        int proxyId = m_moved[i];
+        Body *a = (Body *)tree.GetUserData(proxyId);
+
+        auto callback = [&](int other) {
+            Body *b = (Body *)tree.GetUserData(other);
+            if (other == proxyId || BothStatic(a, b))
+                return true;
+            m_newPairs.push_back(MakePair(a, b));
+            return true;
+        };
+        tree.Query(tree.GetAABB(proxyId), callback);
+    }
+    m_moved.clear();
+
+    std::sort(m_newPairs.begin(), m_newPairs.end(), PairLess);
+    m_newPairs.erase(std::unique(m_newPairs.begin(), m_newPairs.end(), PairEqual), m_newPairs.end());
+
+    // Drop pairs whose fat boxes separated, then merge in the new ones
+    int count = 0;
+    for (int i = 0; i < m_pairs.size(); ++i)
+    {
+        const BodyPair &p = m_pairs[i];
+        if (tree.GetAABB(p.A->proxyId).Overlaps(tree.GetAABB(p.B->proxyId)))
+            m_pairs[count++] = p;
+    }
+    m_pairs.resize(count);
+
+    m_merged.clear();
+    std::set_union(m_pairs.begin(), m_pairs.end(), m_newPairs.begin(), m_newPairs.end(),
+                   std::back_inserter(m_merged), PairLess);
+    m_pairs.swap(m_merged);
+
+    pairs = m_pairs;
+}
+
+unsigned long long PairKey(const BodyPair &p)
+{
+    return (unsigned long long)p.A->id << 32 | p.B->id;
+}
+
+// Cancel events for pairs that were both added and removed during one step
+static void NetEvents(std::vector<BodyPair> &added, std::vector<BodyPair> &removed)
+{
+    std::sort(added.begin(), added.end(), PairLess);
+    std::sort(removed.begin(), removed.end(), PairLess);
+
+    int a = 0, r = 0, outA = 0, outR = 0;
+    while (a < added.size() || r < removed.size())
+    {
+        if (r == removed.size() || (a < added.size() && PairLess(added[a], removed[r])))
+            added[outA++] = added[a++];
+        else if (a == added.size() || PairLess(removed[r], added[a]))
+            removed[outR++] = removed[r++];
+        else
+            ++a, ++r;
+    }
+    added.resize(outA);
+    removed.resize(outR);
+}
+
+void SweepAndPruneBroadphase::Insert(Body *b)
+{
+    int id;
+    if (m_freeProxies.empty())
+    {
+        id = m_proxies.size();
+        m_proxies.push_back(Proxy());
+    }
+    else
+    {
+        id = m_freeProxies.back();
+        m_freeProxies.pop_back();
+    }
+
+    Proxy &proxy = m_proxies[id];
+    proxy.body = b;
+    proxy.aabb = b->Bounds();
+    b->proxyId = id;
+
+    // Appended past every other endpoint, the next sort moves them into place
+    // and reports the overlaps found along the way
+    for (int k = 0; k < 2; ++k)
+    {
+        Endpoint e;
+        e.proxy = id;
+        e.value = FLT_MAX;
+        e.isMax = false;
+        m_axes[k].push_back(e);
+        e.isMax = true;
+        m_axes[k].push_back(e);
+    }
+}
+
+void SweepAndPruneBroadphase::Remove(Body *b)
+{
+    int id = b->proxyId;
+    for (int k = 0; k < 2; ++k)
+    {
+        std::vector<Endpoint> &axis = m_axes[k];
+        int count = 0;
+        for (int i = 0; i < axis.size(); ++i)
+            if (axis[i].proxy != id)
+                axis[count++] = axis[i];
+        axis.resize(count);
+    }
+
+    int count = 0;
+    for (int i = 0; i < m_pairs.size(); ++i)
+    {
+        const BodyPair &p = m_pairs[i];
+        if (p.A == b || p.B == b)
+        {
+            m_pairSet.erase(PairKey(p));
+            m_dropped.push_back(PairKey(p));
+        }
+        else
+            m_pairs[count++] = p;
+    }
+    m_pairs.resize(count);
+
+    // The last step's events must not outlive b either
+    auto touches = [b](const BodyPair &p) { return p.A == b || p.B == b; };
+    added.erase(std::remove_if(added.begin(), added.end(), touches), added.end());
+    removed.erase(std::remove_if(removed.begin(), removed.end(), touches), removed.end());
+
+    m_proxies[id].body = NULL;
+    m_freeProxies.push_back(id);
+    b->proxyId = -1;
+}
+
+void SweepAndPruneBroadphase::AddPair(int a, int b)
+{
+    Proxy &pa = m_proxies[a];
+    Proxy &pb = m_proxies[b];
+    if (BothStatic(pa.body, pb.body) || !pa.aabb.Overlaps(pb.aabb))
+        return;
+
+    BodyPair p = MakePair(pa.body, pb.body);
+    if (m_pairSet.insert(PairKey(p)).second)
+        added.push_back(p);
+}
+
+void SweepAndPruneBroadphase::Clear(void)
+{
+    m_proxies.clear();
+    m_freeProxies.clear();
+    m_axes[0].clear();
+    m_axes[1].clear();
+    m_pairs.clear();
+    m_pairSet.clear();
+    m_dropped.clear();
+    added.clear();
+    removed.clear();
+    dropped.clear();
+}
+
+void SweepAndPruneBroadphase::RemovePair(int a, int b)
+{
+    BodyPair p = MakePair(m_proxies[a].body, m_proxies[b].body);
+    if (m_pairSet.erase(PairKey(p)))
+        removed.push_back(p);
+}
+
+void SweepAndPruneBroadphase::SortAxis(std::vector<Endpoint> &axis)
+{
+    for (int i = 1; i < axis.size(); ++i)
+    {
+        Endpoint e = axis[i];
+        int j = i - 1;
+        for (; j >= 0 && axis[j].value > e.value; --j)
+        {
+            const Endpoint &f = axis[j];
+
+            // A begin point passing an end point starts an overlap on this
+            // axis, an end point passing a begin point finishes one
+            if (!e.isMax && f.isMax)
+                AddPair(e.proxy, f.proxy);
+            else if (e.isMax && !f.isMax)
+                RemovePair(e.proxy, f.proxy);
+
+            axis[j + 1] = f;
+        }
+        axis[j + 1] = e;
+    }
+}
+
+void SweepAndPruneBroadphase::FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs)
+{
+    added.clear();
+    removed.clear();
+    dropped.swap(m_dropped);
+    m_dropped.clear();
+    std::sort(dropped.begin(), dropped.end());
+
+    for (int i = 0; i < bodies.size(); ++i)
+    {
+        Body *b = bodies[i];
+        m_proxies[b->proxyId].aabb = b->Bounds();
+    }
+
+    for (int k = 0; k < 2; ++k)
+    {
+        std::vector<Endpoint> &axis = m_axes[k];
+        for (int i = 0; i < axis.size(); ++i)
+        {
+            const AABB &box = m_proxies[axis[i].proxy].aabb;
+            const Vec &v = axis[i].isMax ? box.max : box.min;
+            axis[i].value = k == 0 ? v.x : v.y;
+        }
+        SortAxis(axis);
+    }
+
+    NetEvents(added, removed);
+
+    // Apply the events to the sorted pair list, Remove has already taken
+    // dropped pairs out of it
+    m_merged.clear();
+    std::set_difference(m_pairs.begin(), m_pairs.end(), removed.begin(), removed.end(),
+                        std::back_inserter(m_merged), PairLess);
+    m_pairs.clear();
+    std::set_union(m_merged.begin(), m_merged.end(), added.begin(), added.end(),
+                   std::back_inserter(m_pairs), PairLess);
+
+    pairs = m_pairs;
+}
@@ -0,0 +1,156 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "PMath.h"
+#include "DynamicTree.h"
+struct Body;
+
+// Candidate pair handed to the narrowphase, A is always the body with the lower id
+struct BodyPair
+{
+    Body *A;
+    Body *B;
+};
+
+// Orders a and b by id
+BodyPair MakePair(Body *a, Body *b);
+
+// Sort by A's id, then B's id
+bool PairLess(const BodyPair &a, const BodyPair &b);
+
+// Both ids packed into one value, for hashing
+unsigned long long PairKey(const BodyPair &p);
+
+// Finds the pairs of bodies whose bounds overlap this step. Pairs where both
+// bodies are static are never reported.
+struct Broadphase
+{
+    virtual ~Broadphase() {}
+
+    // Called by the scene when a body is added or removed
+    virtual void Insert(Body *) {}
+    virtual void Remove(Body *) {}
+
+    // Called when the scene drops every body at once
+    virtual void Clear(void) {}
+
+    // Replace the contents of pairs with this step's candidate pairs, sorted by body id
+    virtual void FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs) = 0;
+};
+
+// Tests every body against every other body
+struct AllPairsBroadphase : public Broadphase
+{
+    void FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs);
+};
+
+// Uniform grid hashed into a flat table. Each body is entered into every cell
+// its AABB touches, and only bodies sharing a cell are paired.
+struct HashGridBroadphase : public Broadphase
+{
+    // Bodies covering more cells than this are tested against everything instead
+    static const int MaxCellsPerBody = 64;
+
+    HashGridBroadphase(Real cellSize)
+        : m_cellSize(cellSize)
+    {
+    }
+
+    void FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs);
+
+    Real m_cellSize;
+
+private:
+    struct Entry
+    {
+        unsigned cell;
+        int body;
+
+        bool operator<(const Entry &rhs) const
+        {
+            return cell < rhs.cell || (cell == rhs.cell && body < rhs.body);
+        }
+    };
+
+    std::vector<AABB> m_aabbs;
+    std::vector<Entry> m_entries;
+    std::vector<int> m_oversized;
+    std::vector<std::pair<int, int>> m_pairs;
+};
+
+// Dynamic AABB tree holding a fattened box per body. A body is only
+// reinserted once its bounds leave its fat box, and only reinserted bodies
+// are queried for new pairs. Existing pairs are kept until their fat boxes
+// stop overlapping.
+struct TreeBroadphase : public Broadphase
+{
+    TreeBroadphase(Real margin)
+        : m_margin(margin), movedCount(0)
+    {
+    }
+
+    void Insert(Body *b);
+    void Remove(Body *b);
+    void Clear(void);
+    void FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs);
+
+    DynamicTree tree;
+    Real m_margin;
+    int movedCount; // Proxies reinserted during the last FindPairs
+
+private:
+    AABB FatAABB(Body *b) const;
+
+    std::vector<int> m_moved;
+    std::vector<BodyPair> m_pairs; // Persistent, sorted by body id
+    std::vector<BodyPair> m_newPairs;
+    std::vector<BodyPair> m_merged;
+};
+
+// Incremental sweep and prune. Box endpoints on both axes are kept sorted
+// between steps and re-sorted with insertion sort, so the work done is
+// proportional to how far bodies moved past each other. Every swap of a
+// begin and end endpoint produces a pair add or remove event.
+struct SweepAndPruneBroadphase : public Broadphase
+{
+    void Insert(Body *b);
+    void Remove(Body *b);
+    void Clear(void);
+    void FindPairs(const std::vector<Body *> &bodies, std::vector<BodyPair> &pairs);
+
+    // Net pair events from the last FindPairs, sorted by body id
+    std::vector<BodyPair> added;
+    std::vector<BodyPair> removed;
+
+    // Pairs dropped by Remove before the last FindPairs, sorted PairKeys.
+    // Their bodies may be gone, so only the ids are kept.
+    std::vector<unsigned long long> dropped;
+
+private:
+    struct Proxy
+    {
+        Body *body;
+        AABB aabb;
+    };
+
+    struct Endpoint
+    {
+        Real value;
+        int proxy;
+        bool isMax;
+    };
+
+    void SortAxis(std::vector<Endpoint> &axis);
+    void AddPair(int a, int b);
+    void RemovePair(int a, int b);
+
+    std::vector<Proxy> m_proxies;
+    std::vector<int> m_freeProxies;
+    std::vector<Endpoint> m_axes[2];
+    std::vector<BodyPair> m_pairs; // Sorted by body id
+    std::vector<BodyPair> m_merged;
+    std::vector<unsigned long long> m_dropped; // PairKeys lost to Remove since the last step
+    std::unordered_set<unsigned long long> m_pairSet;
+};
+
+#endif // BROADPHASE_H
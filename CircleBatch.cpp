@@ -0,0 +1,106 @@
+#include "precompiled.h"
+
+void CircleContactsScalar(const Real *x, const Real *y, const Real *radius,
+                          const int *ia, const int *ib, int count,
+                          Real *penetration, Real *nx, Real *ny,
+                          Real *cx, Real *cy, int *hit)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int a = ia[i];
+        int b = ib[i];
+        Real dx = x[b] - x[a];
+        Real dy = y[b] - y[a];
+        Real dist_sqr = dx * dx + dy * dy;
+        Real r = radius[a] + radius[b];
+
+        hit[i] = dist_sqr < r * r;
+        if (!hit[i])
+            continue;
+
+        Real distance = std::sqrt(dist_sqr);
+        if (distance == 0.0)
+        {
+            penetration[i] = radius[a];
+            nx[i] = 1.0;
+            ny[i] = 0.0;
+            cx[i] = x[a];
+            cy[i] = y[a];
+        }
+        else
+        {
+            penetration[i] = r - distance;
+            nx[i] = dx / distance;
+            ny[i] = dy / distance;
+            cx[i] = nx[i] * radius[a] + x[a];
+            cy[i] = ny[i] * radius[a] + y[a];
+        }
+    }
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+void CircleContactsAVX2(const Real *x, const Real *y, const Real *radius,
+                        const int *ia, const int *ib, int count,
+                        Real *penetration, Real *nx, Real *ny,
+                        Real *cx, Real *cy, int *hit)
+{
+    const VReal zero = VZero();
+    const VReal one = VSet(1);
+
+    int i = 0;
+    for (; i + simdWidth <= count; i += simdWidth)
+    {
+        VReal ax = VGather(x, ia + i);
+        VReal ay = VGather(y, ia + i);
+        VReal ra = VGather(radius, ia + i);
+        VReal dx = VSub(VGather(x, ib + i), ax);
+        VReal dy = VSub(VGather(y, ib + i), ay);
+        VReal r = VAdd(ra, VGather(radius, ib + i));
+
+        VReal distSqr = VAdd(VMul(dx, dx), VMul(dy, dy));
+        int mask = VMask(VLess(distSqr, VMul(r, r)));
+        for (int k = 0; k < simdWidth; ++k)
+            hit[i + k] = (mask >> k) & 1;
+        if (!mask)
+            continue;
+
+        // Coincident centers take the fixed normal CircletoCircle uses
+        VReal distance = VSqrt(distSqr);
+        VReal coincident = VEqual(distance, zero);
+        VReal safe = VBlend(distance, one, coincident);
+
+        VReal n_x = VBlend(VDiv(dx, safe), one, coincident);
+        VReal n_y = VBlend(VDiv(dy, safe), zero, coincident);
+        VReal pen = VBlend(VSub(r, distance), ra, coincident);
+        VReal c_x = VBlend(VAdd(VMul(n_x, ra), ax), ax, coincident);
+        VReal c_y = VBlend(VAdd(VMul(n_y, ra), ay), ay, coincident);
+
+        VStore(penetration + i, pen);
+        VStore(nx + i, n_x);
+        VStore(ny + i, n_y);
+        VStore(cx + i, c_x);
+        VStore(cy + i, c_y);
+    }
+
+    CircleContactsScalar(x, y, radius, ia + i, ib + i, count - i,
+                         penetration + i, nx + i, ny + i, cx + i, cy + i, hit + i);
+}
+#else
+void CircleContactsAVX2(const Real *x, const Real *y, const Real *radius,
+                        const int *ia, const int *ib, int count,
+                        Real *penetration, Real *nx, Real *ny,
+                        Real *cx, Real *cy, int *hit)
+{
+    CircleContactsScalar(x, y, radius, ia, ib, count, penetration, nx, ny, cx, cy, hit);
+}
+#endif
+
+CircleContactsFn SelectCircleContacts(void)
+{
+#ifdef SIMD_X86
+    if (__builtin_cpu_supports("avx2"))
+        return CircleContactsAVX2;
+#endif
+    return CircleContactsScalar;
+}
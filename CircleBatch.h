@@ -0,0 +1,27 @@
+#ifndef CIRCLEBATCH_H
+#define CIRCLEBATCH_H
+
+// Circle-circle contacts for a batch of pairs. Inputs are arrays of body
+// positions and radii indexed by Body::index, pair i tests bodies ia[i] and
+// ib[i]. For touching pairs hit[i] is set and the remaining outputs hold the
+// same values CircletoCircle would produce.
+typedef void (*CircleContactsFn)(const Real *x, const Real *y, const Real *radius,
+                                 const int *ia, const int *ib, int count,
+                                 Real *penetration, Real *nx, Real *ny,
+                                 Real *cx, Real *cy, int *hit);
+
+void CircleContactsScalar(const Real *x, const Real *y, const Real *radius,
+                          const int *ia, const int *ib, int count,
+                          Real *penetration, Real *nx, Real *ny,
+                          Real *cx, Real *cy, int *hit);
+
+// simdWidth pairs per iteration, only call when the CPU supports AVX2
+void CircleContactsAVX2(const Real *x, const Real *y, const Real *radius,
+                        const int *ia, const int *ib, int count,
+                        Real *penetration, Real *nx, Real *ny,
+                        Real *cx, Real *cy, int *hit);
+
+// Best kernel for the running CPU
+CircleContactsFn SelectCircleContacts(void);
+
+#endif // CIRCLEBATCH_H
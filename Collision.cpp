@@ -2,8 +2,9 @@
 
 CollisionCallback Dispatch[Shape::eCount][Shape::eCount] =
     {
-        {CircletoCircle, CircletoPolygon},
-        {PolygontoCircle, PolygontoPolygon},
+        {CircletoCircle, CircletoPolygon, CircletoHull},
+        {PolygontoCircle, PolygontoPolygon, ConvextoConvex},
+        {HulltoCircle, ConvextoConvex, ConvextoConvex},
 };
 
 void CircletoCircle(Manifold *m, Body *a, Body *b)
@@ -12,10 +13,10 @@ void CircletoCircle(Manifold *m, Body *a, Body *b)
     Circle *B = reinterpret_cast<Circle *>(b->shape);
 
     // Calculate translational vector, which is normal
-    Vec normal = b->position - a->position;
+    Vec normal = b->Position() - a->Position();
 
-    double dist_sqr = normal.squared_vec_length();
-    double radius = A->radius + B->radius;
+    Real dist_sqr = normal.squared_vec_length();
+    Real radius = A->radius + B->radius;
 
     // Not in contact
     if (dist_sqr >= radius * radius)
@@ -24,7 +25,7 @@ void CircletoCircle(Manifold *m, Body *a, Body *b)
         return;
     }
 
-    double distance = std::sqrt(dist_sqr);
+    Real distance = std::sqrt(dist_sqr);
 
     m->contact_count = 1;
 
@@ -32,13 +33,13 @@ void CircletoCircle(Manifold *m, Body *a, Body *b)
     {
         m->penetration = A->radius;
         m->normal = Vec(1, 0);
-        m->contacts[0] = a->position;
+        m->contacts[0] = a->Position();
     }
     else
     {
         m->penetration = radius - distance;
         m->normal = normal / distance; // Faster than using Normalized since we already performed sqrt
-        m->contacts[0] = m->normal * A->radius + a->position;
+        m->contacts[0] = m->normal * A->radius + a->Position();
     }
 }
 
@@ -49,17 +50,16 @@ void CircletoPolygon(Manifold *m, Body *a, Body *b)
 
     m->contact_count = 0;
 
-    // Transform circle center to Polygon model space
-    Vec center = a->position;
-    center = B->u.Transpose() * (center - b->position);
+    // Everything below runs on B's cached world space faces
+    Vec center = a->Position();
 
     // Find edge with minimum penetration
     // Exact concept as using support points in Polygon vs Polygon
-    double separation = -FLT_MAX;
+    Real separation = -FLT_MAX;
     int faceNormal = 0;
     for (int i = 0; i < B->m_vertexCount; ++i)
     {
-        double s = Dot(B->m_normals[i], center - B->m_vertices[i]);
+        Real s = Dot(B->m_worldNormals[i], center - B->m_worldVertices[i]);
 
         if (s > A->radius)
             return;
@@ -72,23 +72,24 @@ void CircletoPolygon(Manifold *m, Body *a, Body *b)
     }
 
     // Grab face's vertices
-    Vec v1 = B->m_vertices[faceNormal];
+    Vec v1 = B->m_worldVertices[faceNormal];
     int i2 = faceNormal + 1 < B->m_vertexCount ? faceNormal + 1 : 0;
-    Vec v2 = B->m_vertices[i2];
+    Vec v2 = B->m_worldVertices[i2];
 
     // Check to see if center is within polygon
     if (separation < EPSILON)
     {
         m->contact_count = 1;
-        m->normal = -(B->u * B->m_normals[faceNormal]);
-        m->contacts[0] = m->normal * A->radius + a->position;
+        m->normal = -B->m_worldNormals[faceNormal];
+        m->contacts[0] = m->normal * A->radius + a->Position();
         m->penetration = A->radius;
+        m->features[0] = faceNormal;
         return;
     }
 
     // Determine which voronoi region of the edge center of circle lies within
-    double dot1 = Dot(center - v1, v2 - v1);
-    double dot2 = Dot(center - v2, v1 - v2);
+    Real dot1 = Dot(center - v1, v2 - v1);
+    Real dot2 = Dot(center - v2, v1 - v2);
     m->penetration = A->radius - separation;
 
     // Closest to v1
@@ -99,11 +100,10 @@ void CircletoPolygon(Manifold *m, Body *a, Body *b)
 
         m->contact_count = 1;
         Vec n = v1 - center;
-        n = B->u * n;
         n.Normalize();
         m->normal = n;
-        v1 = B->u * v1 + b->position;
         m->contacts[0] = v1;
+        m->features[0] = 0x100 | faceNormal;
     }
 
     // Closest to v2
@@ -114,9 +114,8 @@ void CircletoPolygon(Manifold *m, Body *a, Body *b)
 
         m->contact_count = 1;
         Vec n = v2 - center;
-        v2 = B->u * v2 + b->position;
         m->contacts[0] = v2;
-        n = B->u * n;
+        m->features[0] = 0x100 | i2;
         n.Normalize();
         m->normal = n;
     }
@@ -124,14 +123,14 @@ void CircletoPolygon(Manifold *m, Body *a, Body *b)
     // Closest to face
     else
     {
-        Vec n = B->m_normals[faceNormal];
+        Vec n = B->m_worldNormals[faceNormal];
         if (Dot(center - v1, n) > A->radius)
             return;
 
-        n = B->u * n;
         m->normal = -n;
-        m->contacts[0] = m->normal * A->radius + a->position;
+        m->contacts[0] = m->normal * A->radius + a->Position();
         m->contact_count = 1;
+        m->features[0] = faceNormal;
     }
 }
 
@@ -141,74 +140,67 @@ void PolygontoCircle(Manifold *m, Body *a, Body *b)
     m->normal = -m->normal;
 }
 
-// double FindAxisLeastPenetration(int *faceIndex, PolygonShape *A, PolygonShape *B)
-// {
-    // double bestDistance = -FLT_MAX;
-    // int bestIndex;
-
-    // for (int i = 0; i < A->m_vertexCount; ++i)
-    // {
-    //     // Retrieve a face normal from A
-    //     Vec n = A->m_normals[i];
-    //     Vec nw = A->u * n;
-
-    //     // Transform face normal into B's model space
-    //     Mat2 buT = B->u.Transpose();
-    //     n = buT * nw;
-
-    //     // Retrieve support point from B along -n
-    //     Vec s = B->GetSupport(-n);
-
-    //     // Retrieve vertex on face from A, transform into
-    //     // B's model space
-    //     Vec v = A->m_vertices[i];
-    //     v = A->u * v + A->body->position;
-    //     v -= B->body->position;
-    //     v = buT * v;
-
-    //     // Compute penetration distance (in B's model space)
-    //     double d = Dot(n, s - v);
-
-    //     // Store greatest distance
-    //     if (d > bestDistance)
-    //     {
-    //         bestDistance = d;
-    //         bestIndex = i;
-    //     }
-    // }
-
-    // *faceIndex = bestIndex;
-    // return bestDistance;
-// }
-
-// void FindIncidentFace(Vec *v, PolygonShape *RefPoly, PolygonShape *IncPoly, int referenceIndex)
-// {
-//     Vec referenceNormal = RefPoly->m_normals[referenceIndex];
-
-//     // Calculate normal in incident's frame of reference
-//     referenceNormal = RefPoly->u * referenceNormal;             // To world space
-//     referenceNormal = IncPoly->u.Transpose() * referenceNormal; // To incident's model space
-
-//     // Find most anti-normal face on incident polygon
-//     int incidentFace = 0;
-//     double minDot = FLT_MAX;
-//     for (int i = 0; i < IncPoly->m_vertexCount; ++i)
-//     {
-//         double dot = Dot(referenceNormal, IncPoly->m_normals[i]);
-//         if (dot < minDot)
-//         {
-//             minDot = dot;
-//             incidentFace = i;
-//         }
-//     }
-
-//     // Assign face vertices for incidentFace
-//     v[0] = IncPoly->u * IncPoly->m_vertices[incidentFace] + IncPoly->body->position;
-//     incidentFace = incidentFace + 1 >= (int)IncPoly->m_vertexCount ? 0 : incidentFace + 1;
-//     v[1] = IncPoly->u * IncPoly->m_vertices[incidentFace] + IncPoly->body->position;
-// }
-
-int Clip(Vec n, double c, Vec *face)
+inline bool BiasGreaterThan(Real a, Real b)
+{
+    const Real k_biasRelative = 0.95;
+    const Real k_biasAbsolute = 0.01;
+    return a >= b * k_biasRelative + a * k_biasAbsolute;
+}
+
+// Distance of B's deepest point from face i of A, negative when penetrating.
+// Like FindIncidentFace, only used by the SAT path on cached small polygons.
+Real FaceSeparation(int i, PolygonShape *A, PolygonShape *B)
+{
+    // Face normal and vertex of A, support point of B along -n, all world space
+    Vec n = A->m_worldNormals[i];
+    Vec s = B->m_worldVertices[B->WorldSupportIndex(-n)];
+    Vec v = A->m_worldVertices[i];
+
+    return Dot(n, s - v);
+}
+
+Real FindAxisLeastPenetration(int *faceIndex, PolygonShape *A, PolygonShape *B)
+{
+    Real bestDistance = -FLT_MAX;
+    int bestIndex = 0;
+
+    for (int i = 0; i < A->m_vertexCount; ++i)
+    {
+        Real d = FaceSeparation(i, A, B);
+
+        // Store greatest distance
+        if (d > bestDistance)
+        {
+            bestDistance = d;
+            bestIndex = i;
+        }
+    }
+
+    *faceIndex = bestIndex;
+    return bestDistance;
+}
+
+int FindIncidentFace(PolygonShape *RefPoly, PolygonShape *IncPoly, int referenceIndex)
+{
+    Vec referenceNormal = RefPoly->m_worldNormals[referenceIndex];
+
+    // Find most anti-normal face on incident polygon
+    int incidentFace = 0;
+    Real minDot = FLT_MAX;
+    for (int i = 0; i < IncPoly->m_vertexCount; ++i)
+    {
+        Real dot = Dot(referenceNormal, IncPoly->m_worldNormals[i]);
+        if (dot < minDot)
+        {
+            minDot = dot;
+            incidentFace = i;
+        }
+    }
+
+    return incidentFace;
+}
+
+int Clip(Vec n, Real c, Vec *face)
 {
     int sp = 0;
     Vec out[2] = {
@@ -217,8 +209,8 @@ int Clip(Vec n, double c, Vec *face)
 
     // Retrieve distances from each endpoint to the line
     // d = ax + by - c
-    double d1 = Dot(n, face[0]) - c;
-    double d2 = Dot(n, face[1]) - c;
+    Real d1 = Dot(n, face[0]) - c;
+    Real d2 = Dot(n, face[1]) - c;
 
     // If negative (behind plane) clip
     if (d1 <= 0.0f)
@@ -230,7 +222,7 @@ int Clip(Vec n, double c, Vec *face)
     if (d1 * d2 < 0.0f) // less than to ignore -0.0f
     {
         // Push interesection point
-        double alpha = d1 / (d1 - d2);
+        Real alpha = d1 / (d1 - d2);
         out[sp] = face[0] + alpha * (face[1] - face[0]);
         ++sp;
     }
@@ -244,119 +236,193 @@ int Clip(Vec n, double c, Vec *face)
     return sp;
 }
 
+// Clip the incident face of IncPoly against the reference face and store
+// the points found behind it. Either may be a large hull.
+void ClipReferenceFace(Manifold *m, PolygonShape *RefPoly, PolygonShape *IncPoly, int referenceIndex, int incidentIndex, bool flip)
+{
+    // Contact ids are the face pair plus the point's place along the reference face
+    unsigned feature = (unsigned)flip << 31 | (unsigned)referenceIndex << 16 | (unsigned)incidentIndex << 1;
+
+    // World space incident face
+    Vec incidentFace[2];
+    incidentFace[0] = IncPoly->WorldVertex(incidentIndex);
+    incidentIndex = incidentIndex + 1 >= (int)IncPoly->m_vertexCount ? 0 : incidentIndex + 1;
+    incidentFace[1] = IncPoly->WorldVertex(incidentIndex);
+
+    //        y
+    //        ^  ->n       ^
+    //      +---c ------posPlane--
+    //  x < | i |\ .
+    //      +---+ c-----negPlane--
+    //             \       v
+    //              r
+    //
+    //  r : reference face
+    //  i : incident poly
+    //  c : clipped point
+    //  n : incident normal
+
+    // Setup reference face vertices
+    Vec v1 = RefPoly->WorldVertex(referenceIndex);
+    referenceIndex = referenceIndex + 1 == RefPoly->m_vertexCount ? 0 : referenceIndex + 1;
+    Vec v2 = RefPoly->WorldVertex(referenceIndex);
+
+    // Calculate reference face side normal in world space
+    Vec sidePlaneNormal = (v2 - v1);
+    sidePlaneNormal.Normalize();
+
+    // Orthogonalize
+    Vec refFaceNormal(sidePlaneNormal.y, -sidePlaneNormal.x);
+
+    // ax + by = c
+    // c is distance from origin
+    Real refC = Dot(refFaceNormal, v1);
+    Real negSide = -Dot(sidePlaneNormal, v1);
+    Real posSide = Dot(sidePlaneNormal, v2);
+
+    // Clip incident face to reference face side planes
+    if (Clip(-sidePlaneNormal, negSide, incidentFace) < 2)
+        return; // Due to floating point error, possible to not have required points
+
+    if (Clip(sidePlaneNormal, posSide, incidentFace) < 2)
+        return; // Due to floating point error, possible to not have required points
+
+    // Flip
+    m->normal = flip ? -refFaceNormal : refFaceNormal;
+
+    // Keep points behind reference face
+    int cp = 0; // clipped points behind reference face
+    Real separation = Dot(refFaceNormal, incidentFace[0]) - refC;
+    if (separation <= 0.0f)
+    {
+        m->contacts[cp] = incidentFace[0];
+        m->depth[cp] = -separation;
+        m->penetration = -separation;
+        ++cp;
+    }
+    else
+        m->penetration = 0;
+
+    separation = Dot(refFaceNormal, incidentFace[1]) - refC;
+    if (separation <= 0.0f)
+    {
+        m->contacts[cp] = incidentFace[1];
+        m->depth[cp] = -separation;
+
+        m->penetration += -separation;
+        ++cp;
+
+        // Average penetration
+        m->penetration /= (Real)cp;
+    }
+
+    m->contact_count = cp;
+
+    // Order the points along the reference face so ids stay stable
+    if (cp == 2 && Dot(sidePlaneNormal, m->contacts[0]) > Dot(sidePlaneNormal, m->contacts[1]))
+    {
+        std::swap(m->contacts[0], m->contacts[1]);
+        std::swap(m->depth[0], m->depth[1]);
+    }
+    for (int i = 0; i < cp; ++i)
+        m->features[i] = feature | i;
+    if (cp == 1 && 2.0 * Dot(sidePlaneNormal, m->contacts[0]) > posSide - negSide)
+        m->features[0] = feature | 1;
+}
+
+// Pose of b in a's frame, used to tell whether a cached reference face is still good
+static void RelativePose(Body *a, Body *b, Vec *position, Rotor *rotation)
+{
+    *position = a->shape->u.Transpose() * (b->Position() - a->Position());
+    *rotation = b->Rotation().Relative(a->Rotation());
+}
+
 void PolygontoPolygon(Manifold *m, Body *a, Body *b)
 {
-//     PolygonShape *A = reinterpret_cast<PolygonShape *>(a->shape);
-//     PolygonShape *B = reinterpret_cast<PolygonShape *>(b->shape);
-//     m->contact_count = 0;
-
-//     // Check for a separating axis with A's face planes
-//     int faceA;
-//     double penetrationA = FindAxisLeastPenetration(&faceA, A, B);
-//     if (penetrationA >= 0.0f)
-//         return;
-
-//     // Check for a separating axis with B's face planes
-//     int faceB;
-//     double penetrationB = FindAxisLeastPenetration(&faceB, B, A);
-//     if (penetrationB >= 0.0f)
-//         return;
-
-//     int referenceIndex;
-//     bool flip; // Always point from a to b
-
-//     PolygonShape *RefPoly; // Reference
-//     PolygonShape *IncPoly; // Incident
-
-//     // Determine which shape contains reference face
-//     if (BiasGreaterThan(penetrationA, penetrationB))
-//     {
-//         RefPoly = A;
-//         IncPoly = B;
-//         referenceIndex = faceA;
-//         flip = false;
-//     }
-
-//     else
-//     {
-//         RefPoly = B;
-//         IncPoly = A;
-//         referenceIndex = faceB;
-//         flip = true;
-//     }
-
-//     // World space incident face
-//     Vec incidentFace[2];
-//     FindIncidentFace(incidentFace, RefPoly, IncPoly, referenceIndex);
-
-//     //        y
-//     //        ^  ->n       ^
-//     //      +---c ------posPlane--
-//     //  x < | i |\
-//   //      +---+ c-----negPlane--
-//     //             \       v
-//     //              r
-//     //
-//     //  r : reference face
-//     //  i : incident poly
-//     //  c : clipped point
-//     //  n : incident normal
-
-//     // Setup reference face vertices
-//     Vec v1 = RefPoly->m_vertices[referenceIndex];
-//     referenceIndex = referenceIndex + 1 == RefPoly->m_vertexCount ? 0 : referenceIndex + 1;
-//     Vec v2 = RefPoly->m_vertices[referenceIndex];
-
-//     // Transform vertices to world space
-//     v1 = RefPoly->u * v1 + RefPoly->body->position;
-//     v2 = RefPoly->u * v2 + RefPoly->body->position;
-
-//     // Calculate reference face side normal in world space
-//     Vec sidePlaneNormal = (v2 - v1);
-//     sidePlaneNormal.Normalize();
-
-//     // Orthogonalize
-//     Vec refFaceNormal(sidePlaneNormal.y, -sidePlaneNormal.x);
-
-//     // ax + by = c
-//     // c is distance from origin
-//     double refC = Dot(refFaceNormal, v1);
-//     double negSide = -Dot(sidePlaneNormal, v1);
-//     double posSide = Dot(sidePlaneNormal, v2);
-
-//     // Clip incident face to reference face side planes
-//     if (Clip(-sidePlaneNormal, negSide, incidentFace) < 2)
-//         return; // Due to floating point error, possible to not have required points
-
-//     if (Clip(sidePlaneNormal, posSide, incidentFace) < 2)
-//         return; // Due to floating point error, possible to not have required points
-
-//     // Flip
-//     m->normal = flip ? -refFaceNormal : refFaceNormal;
-
-//     // Keep points behind reference face
-//     int cp = 0; // clipped points behind reference face
-//     double separation = Dot(refFaceNormal, incidentFace[0]) - refC;
-//     if (separation <= 0.0f)
-//     {
-//         m->contacts[cp] = incidentFace[0];
-//         m->penetration = -separation;
-//         ++cp;
-//     }
-//     else
-//         m->penetration = 0;
-
-//     separation = Dot(refFaceNormal, incidentFace[1]) - refC;
-//     if (separation <= 0.0f)
-//     {
-//         m->contacts[cp] = incidentFace[1];
-
-//         m->penetration += -separation;
-//         ++cp;
-
-//         // Average penetration
-//         m->penetration /= (double)cp;
-//     }
-
-//     m->contact_count = cp;
+    PolygonShape *A = reinterpret_cast<PolygonShape *>(a->shape);
+    PolygonShape *B = reinterpret_cast<PolygonShape *>(b->shape);
+    m->contact_count = 0;
+
+    // Try last step's answer first
+    SATCache *cache = m->sat;
+    if (cache && cache->valid)
+    {
+        PolygonShape *RefPoly = cache->flip ? B : A;
+        PolygonShape *IncPoly = cache->flip ? A : B;
+
+        // A separating axis usually stays separating
+        if (cache->separated)
+        {
+            if (FaceSeparation(cache->face, RefPoly, IncPoly) >= 0.0f)
+                return;
+        }
+
+        // Resting pairs keep their reference face while the pose barely moves
+        else
+        {
+            Vec position;
+            Rotor rotation;
+            RelativePose(a, b, &position, &rotation);
+            Rotor turn = rotation.Relative(cache->rotation);
+            if ((position - cache->position).squared_vec_length() < Sqr(SATCache::LinearTolerance) &&
+                turn.c > 0 && std::abs(turn.s) < SATCache::AngularTolerance)
+            {
+                ClipReferenceFace(m, RefPoly, IncPoly, cache->face,
+                                  FindIncidentFace(RefPoly, IncPoly, cache->face), cache->flip);
+                return;
+            }
+        }
+    }
+
+    // Check for a separating axis with A's face planes
+    int faceA;
+    Real penetrationA = FindAxisLeastPenetration(&faceA, A, B);
+    if (penetrationA >= 0.0f)
+    {
+        if (cache)
+            cache->Set(true, false, faceA);
+        return;
+    }
+
+    // Check for a separating axis with B's face planes
+    int faceB;
+    Real penetrationB = FindAxisLeastPenetration(&faceB, B, A);
+    if (penetrationB >= 0.0f)
+    {
+        if (cache)
+            cache->Set(true, true, faceB);
+        return;
+    }
+
+    int referenceIndex;
+    bool flip; // Always point from a to b
+
+    PolygonShape *RefPoly; // Reference
+    PolygonShape *IncPoly; // Incident
+
+    // Determine which shape contains reference face
+    if (BiasGreaterThan(penetrationA, penetrationB))
+    {
+        RefPoly = A;
+        IncPoly = B;
+        referenceIndex = faceA;
+        flip = false;
+    }
+
+    else
+    {
+        RefPoly = B;
+        IncPoly = A;
+        referenceIndex = faceB;
+        flip = true;
+    }
+
+    if (cache)
+    {
+        cache->Set(false, flip, referenceIndex);
+        RelativePose(a, b, &cache->position, &cache->rotation);
+    }
+
+    ClipReferenceFace(m, RefPoly, IncPoly, referenceIndex,
+                      FindIncidentFace(RefPoly, IncPoly, referenceIndex), flip);
 }
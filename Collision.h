@@ -6,6 +6,35 @@
 struct Manifold;
 struct Body;
 
+// Outcome of the last polygon SAT query for a body pair. The scene keeps it
+// between steps so coherent pairs can skip the full search.
+struct SATCache
+{
+    static constexpr Real LinearTolerance = 0.5;   // Pixels
+    static constexpr Real AngularTolerance = 0.02; // Radians, compared against the sine of the turn
+
+    SATCache()
+        : valid(false), step(0)
+    {
+    }
+
+    void Set(bool separated_, bool flip_, int face_)
+    {
+        valid = true;
+        separated = separated_;
+        flip = flip_;
+        face = face_;
+    }
+
+    bool valid;
+    bool separated; // face is a separating axis, otherwise the reference face
+    bool flip;      // face belongs to B
+    int face;
+    Vec position;   // Pose of B in A's frame when face was picked
+    Rotor rotation;
+    unsigned step;  // Last step the pair was a candidate
+};
+
 typedef void (*CollisionCallback)( Manifold *m, Body *a, Body *b );
 
 extern CollisionCallback Dispatch[Shape::eCount][Shape::eCount];
@@ -15,4 +44,13 @@ void CircletoPolygon( Manifold *m, Body *a, Body *b );
 void PolygontoCircle( Manifold *m, Body *a, Body *b );
 void PolygontoPolygon( Manifold *m, Body *a, Body *b );
 
+// GJK/EPA paths for large hulls, see GJK.cpp
+void CircletoHull( Manifold *m, Body *a, Body *b );
+void HulltoCircle( Manifold *m, Body *a, Body *b );
+void ConvextoConvex( Manifold *m, Body *a, Body *b );
+
+int FindIncidentFace( PolygonShape *RefPoly, PolygonShape *IncPoly, int referenceIndex );
+void ClipReferenceFace( Manifold *m, PolygonShape *RefPoly, PolygonShape *IncPoly,
+                        int referenceIndex, int incidentIndex, bool flip );
+
 #endif // COLLISION_H
\ No newline at end of file
@@ -0,0 +1,553 @@
+#include "precompiled.h"
+
+void ContactSolver::Resize(int bodyCount, int constraintCount)
+{
+    vx.resize(bodyCount);
+    vy.resize(bodyCount);
+    w.resize(bodyCount);
+    im.resize(bodyCount);
+    iI.resize(bodyCount);
+    ax.resize(bodyCount);
+    ay.resize(bodyCount);
+    aw.resize(bodyCount);
+    dx.resize(bodyCount);
+    dy.resize(bodyCount);
+    dq.resize(bodyCount);
+
+    contact.resize(constraintCount);
+    bodyA.resize(constraintCount);
+    bodyB.resize(constraintCount);
+    pointCount.resize(constraintCount);
+    nx.resize(constraintCount);
+    ny.resize(constraintCount);
+    staticFriction.resize(constraintCount);
+    dynamicFriction.resize(constraintCount);
+
+    int points = 2 * constraintCount;
+    rax.resize(points);
+    ray.resize(points);
+    rbx.resize(points);
+    rby.resize(points);
+    normalMass.resize(points);
+    tangentMass.resize(points);
+    bias.resize(points);
+    separation.resize(points);
+    normalImpulse.resize(points);
+    tangentImpulse.resize(points);
+}
+
+void ContactSolver::LoadBody(const BodyStore &store, int i)
+{
+    vx[i] = store.velocity[i].x;
+    vy[i] = store.velocity[i].y;
+    w[i] = store.angularVelocity[i];
+    im[i] = store.im[i];
+    iI[i] = store.iI[i];
+    ax[i] = store.force[i].x * im[i] + gravity.x;
+    ay[i] = store.force[i].y * im[i] + gravity.y;
+    aw[i] = store.torque[i] * iI[i];
+    dx[i] = 0;
+    dy[i] = 0;
+    dq[i] = 0;
+}
+
+void ContactSolver::StoreBody(BodyStore &store, int i) const
+{
+    store.velocity[i].Set(vx[i], vy[i]);
+    store.angularVelocity[i] = w[i];
+}
+
+void ContactSolver::IntegrateVelocity(int i, Real h)
+{
+    vx[i] += ax[i] * h;
+    vy[i] += ay[i] * h;
+    w[i] += aw[i] * h;
+}
+
+void ContactSolver::IntegratePosition(int i, Real h)
+{
+    dx[i] += vx[i] * h;
+    dy[i] += vy[i] * h;
+    dq[i] += w[i] * h;
+}
+
+void ContactSolver::StorePosition(BodyStore &store, int i) const
+{
+    store.position[i] += Vec(dx[i], dy[i]);
+    store.rotation[i] = store.rotation[i].Integrate(dq[i]);
+}
+
+void ContactSolver::WarmStart(int begin, int end)
+{
+    for (int c = begin; c < end; ++c)
+    {
+        int a = bodyA[c];
+        int b = bodyB[c];
+        Real tx = ny[c];
+        Real ty = -nx[c];
+
+        for (int j = 0; j < pointCount[c]; ++j)
+        {
+            int p = 2 * c + j;
+            Real Px = nx[c] * normalImpulse[p] + tx * tangentImpulse[p];
+            Real Py = ny[c] * normalImpulse[p] + ty * tangentImpulse[p];
+            if (a >= 0)
+            {
+                vx[a] -= im[a] * Px;
+                vy[a] -= im[a] * Py;
+                w[a] -= iI[a] * (rax[p] * Py - ray[p] * Px);
+            }
+            if (b >= 0)
+            {
+                vx[b] += im[b] * Px;
+                vy[b] += im[b] * Py;
+                w[b] += iI[b] * (rbx[p] * Py - rby[p] * Px);
+            }
+        }
+    }
+}
+
+Real ContactSolver::Solve(int begin, int end)
+{
+    Real residual = 0;
+    for (int c = begin; c < end; ++c)
+    {
+        // Statics read as zero velocity and infinite mass
+        int a = bodyA[c];
+        int b = bodyB[c];
+        Real vax = 0, vay = 0, wa = 0, ima = 0, iia = 0;
+        Real vbx = 0, vby = 0, wb = 0, imb = 0, iib = 0;
+        if (a >= 0)
+        {
+            vax = vx[a];
+            vay = vy[a];
+            wa = w[a];
+            ima = im[a];
+            iia = iI[a];
+        }
+        if (b >= 0)
+        {
+            vbx = vx[b];
+            vby = vy[b];
+            wb = w[b];
+            imb = im[b];
+            iib = iI[b];
+        }
+
+        Real cnx = nx[c];
+        Real cny = ny[c];
+        Real tx = cny;
+        Real ty = -cnx;
+
+        for (int j = 0; j < pointCount[c]; ++j)
+        {
+            int p = 2 * c + j;
+
+            // Relative velocity at the contact
+            Real dvx = vbx - wb * rby[p] - vax + wa * ray[p];
+            Real dvy = vby + wb * rbx[p] - vay - wa * rax[p];
+
+            // Normal impulse, the total over the step may only push
+            Real vn = dvx * cnx + dvy * cny;
+            Real lambda = -normalMass[p] * (vn - bias[p]);
+            Real newImpulse = std::max(normalImpulse[p] + lambda, Real(0));
+            lambda = newImpulse - normalImpulse[p];
+            normalImpulse[p] = newImpulse;
+            residual = std::max(residual, std::abs(lambda) / normalMass[p]);
+
+            Real Px = lambda * cnx;
+            Real Py = lambda * cny;
+            vax -= ima * Px;
+            vay -= ima * Py;
+            wa -= iia * (rax[p] * Py - ray[p] * Px);
+            vbx += imb * Px;
+            vby += imb * Py;
+            wb += iib * (rbx[p] * Py - rby[p] * Px);
+
+            // Friction impulse
+            dvx = vbx - wb * rby[p] - vax + wa * ray[p];
+            dvy = vby + wb * rbx[p] - vay - wa * rax[p];
+            Real vt = dvx * tx + dvy * ty;
+            lambda = -tangentMass[p] * vt;
+
+            // Coulumb's law, sticking up to the static limit then sliding
+            Real total = tangentImpulse[p] + lambda;
+            if (std::abs(total) > staticFriction[c] * normalImpulse[p])
+                total = total > 0 ? dynamicFriction[c] * normalImpulse[p] : -dynamicFriction[c] * normalImpulse[p];
+            lambda = total - tangentImpulse[p];
+            tangentImpulse[p] = total;
+            residual = std::max(residual, std::abs(lambda) / tangentMass[p]);
+
+            Px = lambda * tx;
+            Py = lambda * ty;
+            vax -= ima * Px;
+            vay -= ima * Py;
+            wa -= iia * (rax[p] * Py - ray[p] * Px);
+            vbx += imb * Px;
+            vby += imb * Py;
+            wb += iib * (rbx[p] * Py - rby[p] * Px);
+        }
+
+        if (a >= 0)
+        {
+            vx[a] = vax;
+            vy[a] = vay;
+            w[a] = wa;
+        }
+        if (b >= 0)
+        {
+            vx[b] = vbx;
+            vy[b] = vby;
+            w[b] = wb;
+        }
+    }
+    return residual;
+}
+
+// Soft contact tuning, in the engine's pixel units
+const Real contactHertz = 30.0;
+const Real contactDampingRatio = 10.0;
+const Real maxBiasVelocity = 100.0; // Fastest a soft contact pushes apart
+const Real linearSlop = 0.05;       // Penetration allowance
+
+void ContactSolver::SetSoftness(Real h)
+{
+    // Stiffer than a quarter of the substep rate rings
+    Real hertz = std::min(contactHertz, Real(0.25) / h);
+    Real omega = 2.0 * PI * hertz;
+    Real a1 = 2.0 * contactDampingRatio + h * omega;
+    Real a2 = h * omega * a1;
+    Real a3 = 1.0 / (1.0 + a2);
+    biasRate = omega / a1;
+    massScale = a2 * a3;
+    impulseScale = a3;
+    inv_h = 1.0 / h;
+}
+
+Real ContactSolver::SolveSoft(int begin, int end, bool useBias)
+{
+    Real residual = 0;
+    for (int c = begin; c < end; ++c)
+    {
+        int a = bodyA[c];
+        int b = bodyB[c];
+        Real vax = 0, vay = 0, wa = 0, ima = 0, iia = 0, dxa = 0, dya = 0, dqa = 0;
+        Real vbx = 0, vby = 0, wb = 0, imb = 0, iib = 0, dxb = 0, dyb = 0, dqb = 0;
+        if (a >= 0)
+        {
+            vax = vx[a];
+            vay = vy[a];
+            wa = w[a];
+            ima = im[a];
+            iia = iI[a];
+            dxa = dx[a];
+            dya = dy[a];
+            dqa = dq[a];
+        }
+        if (b >= 0)
+        {
+            vbx = vx[b];
+            vby = vy[b];
+            wb = w[b];
+            imb = im[b];
+            iib = iI[b];
+            dxb = dx[b];
+            dyb = dy[b];
+            dqb = dq[b];
+        }
+
+        Real cnx = nx[c];
+        Real cny = ny[c];
+        Real tx = cny;
+        Real ty = -cnx;
+
+        for (int j = 0; j < pointCount[c]; ++j)
+        {
+            int p = 2 * c + j;
+
+            // Separation now, from how far each anchor moved since the narrowphase
+            Real ddx = (dxb - dqb * rby[p]) - (dxa - dqa * ray[p]);
+            Real ddy = (dyb + dqb * rbx[p]) - (dya + dqa * rax[p]);
+            Real s = separation[p] + linearSlop + ddx * cnx + ddy * cny;
+
+            Real bias = 0;
+            Real mScale = 1;
+            Real iScale = 0;
+            if (s > 0)
+            {
+                // Not touching yet, only stop what would close the gap this substep
+                bias = s * inv_h;
+            }
+            else if (useBias)
+            {
+                bias = std::max(biasRate * s, -maxBiasVelocity);
+                mScale = massScale;
+                iScale = impulseScale;
+            }
+
+            Real dvx = vbx - wb * rby[p] - vax + wa * ray[p];
+            Real dvy = vby + wb * rbx[p] - vay - wa * rax[p];
+
+            // Normal impulse, the total over the substep may only push
+            Real vn = dvx * cnx + dvy * cny;
+            Real lambda = -normalMass[p] * mScale * (vn + bias) - iScale * normalImpulse[p];
+            Real newImpulse = std::max(normalImpulse[p] + lambda, Real(0));
+            lambda = newImpulse - normalImpulse[p];
+            normalImpulse[p] = newImpulse;
+            residual = std::max(residual, std::abs(lambda) / normalMass[p]);
+
+            Real Px = lambda * cnx;
+            Real Py = lambda * cny;
+            vax -= ima * Px;
+            vay -= ima * Py;
+            wa -= iia * (rax[p] * Py - ray[p] * Px);
+            vbx += imb * Px;
+            vby += imb * Py;
+            wb += iib * (rbx[p] * Py - rby[p] * Px);
+
+            // Friction impulse
+            dvx = vbx - wb * rby[p] - vax + wa * ray[p];
+            dvy = vby + wb * rbx[p] - vay - wa * rax[p];
+            Real vt = dvx * tx + dvy * ty;
+            lambda = -tangentMass[p] * vt;
+
+            // Coulumb's law, sticking up to the static limit then sliding
+            Real total = tangentImpulse[p] + lambda;
+            if (std::abs(total) > staticFriction[c] * normalImpulse[p])
+                total = total > 0 ? dynamicFriction[c] * normalImpulse[p] : -dynamicFriction[c] * normalImpulse[p];
+            lambda = total - tangentImpulse[p];
+            tangentImpulse[p] = total;
+            residual = std::max(residual, std::abs(lambda) / tangentMass[p]);
+
+            Px = lambda * tx;
+            Py = lambda * ty;
+            vax -= ima * Px;
+            vay -= ima * Py;
+            wa -= iia * (rax[p] * Py - ray[p] * Px);
+            vbx += imb * Px;
+            vby += imb * Py;
+            wb += iib * (rbx[p] * Py - rby[p] * Px);
+        }
+
+        if (a >= 0)
+        {
+            vx[a] = vax;
+            vy[a] = vay;
+            w[a] = wa;
+        }
+        if (b >= 0)
+        {
+            vx[b] = vbx;
+            vy[b] = vby;
+            w[b] = wb;
+        }
+    }
+    return residual;
+}
+
+void ContactSolver::ApplyRestitution(int begin, int end)
+{
+    for (int c = begin; c < end; ++c)
+    {
+        int a = bodyA[c];
+        int b = bodyB[c];
+        for (int j = 0; j < pointCount[c]; ++j)
+        {
+            int p = 2 * c + j;
+            if (bias[p] == 0)
+                continue;
+
+            Real vax = 0, vay = 0, wa = 0;
+            Real vbx = 0, vby = 0, wb = 0;
+            if (a >= 0)
+            {
+                vax = vx[a];
+                vay = vy[a];
+                wa = w[a];
+            }
+            if (b >= 0)
+            {
+                vbx = vx[b];
+                vby = vy[b];
+                wb = w[b];
+            }
+
+            Real dvx = vbx - wb * rby[p] - vax + wa * ray[p];
+            Real dvy = vby + wb * rbx[p] - vay - wa * rax[p];
+            Real vn = dvx * nx[c] + dvy * ny[c];
+            Real lambda = -normalMass[p] * (vn - bias[p]);
+            Real newImpulse = std::max(normalImpulse[p] + lambda, Real(0));
+            lambda = newImpulse - normalImpulse[p];
+            normalImpulse[p] = newImpulse;
+
+            Real Px = lambda * nx[c];
+            Real Py = lambda * ny[c];
+            if (a >= 0)
+            {
+                vx[a] -= im[a] * Px;
+                vy[a] -= im[a] * Py;
+                w[a] -= iI[a] * (rax[p] * Py - ray[p] * Px);
+            }
+            if (b >= 0)
+            {
+                vx[b] += im[b] * Px;
+                vy[b] += im[b] * Py;
+                w[b] += iI[b] * (rbx[p] * Py - rby[p] * Px);
+            }
+        }
+    }
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+Real ContactSolver::SolveWide(int begin, int end)
+{
+    const VReal zero = VZero();
+    const VReal signMask = VSet(-0.0);
+    VReal residual = zero;
+
+    int c = begin;
+    for (; c + simdWidth <= end; c += simdWidth)
+    {
+        // Gather both bodies of every lane, statics come back as zero
+        const int *ia = &bodyA[c];
+        const int *ib = &bodyB[c];
+        VReal hasA = VIntGreater(ia, -1);
+        VReal hasB = VIntGreater(ib, -1);
+
+        VReal vax = VGather(&vx[0], ia, hasA);
+        VReal vay = VGather(&vy[0], ia, hasA);
+        VReal wa = VGather(&w[0], ia, hasA);
+        VReal ima = VGather(&im[0], ia, hasA);
+        VReal iia = VGather(&iI[0], ia, hasA);
+        VReal vbx = VGather(&vx[0], ib, hasB);
+        VReal vby = VGather(&vy[0], ib, hasB);
+        VReal wb = VGather(&w[0], ib, hasB);
+        VReal imb = VGather(&im[0], ib, hasB);
+        VReal iib = VGather(&iI[0], ib, hasB);
+
+        VReal cnx = VLoad(&nx[c]);
+        VReal cny = VLoad(&ny[c]);
+        VReal tx = cny;
+        VReal ty = VXor(cnx, signMask);
+        VReal sf = VLoad(&staticFriction[c]);
+        VReal df = VLoad(&dynamicFriction[c]);
+
+        // Lanes with a second point
+        VReal second = VIntGreater(&pointCount[c], 1);
+
+        VReal Rax[2], Ray[2], Rbx[2], Rby[2], Nm[2], Tm[2], Bias[2], Ni[2], Ti[2];
+        int p = 2 * c;
+        VLoadPoints(&rax[p], &Rax[0], &Rax[1]);
+        VLoadPoints(&ray[p], &Ray[0], &Ray[1]);
+        VLoadPoints(&rbx[p], &Rbx[0], &Rbx[1]);
+        VLoadPoints(&rby[p], &Rby[0], &Rby[1]);
+        VLoadPoints(&normalMass[p], &Nm[0], &Nm[1]);
+        VLoadPoints(&tangentMass[p], &Tm[0], &Tm[1]);
+        VLoadPoints(&bias[p], &Bias[0], &Bias[1]);
+        VLoadPoints(&normalImpulse[p], &Ni[0], &Ni[1]);
+        VLoadPoints(&tangentImpulse[p], &Ti[0], &Ti[1]);
+
+        int points = VMask(second) ? 2 : 1;
+        for (int j = 0; j < points; ++j)
+        {
+            // Lanes without this point keep their impulses and apply nothing
+            VReal valid = j == 0 ? VTrue() : second;
+
+            // Relative velocity at the contact
+            VReal dvx = VSub(VSub(vbx, VMul(wb, Rby[j])), VSub(vax, VMul(wa, Ray[j])));
+            VReal dvy = VSub(VAdd(vby, VMul(wb, Rbx[j])), VAdd(vay, VMul(wa, Rax[j])));
+
+            // Normal impulse, the total over the step may only push
+            VReal vn = VAdd(VMul(dvx, cnx), VMul(dvy, cny));
+            VReal lambda = VMul(VXor(Nm[j], signMask), VSub(vn, Bias[j]));
+            VReal newImpulse = VMax(VAdd(Ni[j], lambda), zero);
+            lambda = VAnd(VSub(newImpulse, Ni[j]), valid);
+            Ni[j] = VAdd(Ni[j], lambda);
+            VReal change = VAnd(VDiv(VAndNot(signMask, lambda), Nm[j]), valid);
+            residual = VMax(residual, change);
+
+            VReal Px = VMul(lambda, cnx);
+            VReal Py = VMul(lambda, cny);
+            vax = VSub(vax, VMul(ima, Px));
+            vay = VSub(vay, VMul(ima, Py));
+            wa = VSub(wa, VMul(iia, VSub(VMul(Rax[j], Py), VMul(Ray[j], Px))));
+            vbx = VAdd(vbx, VMul(imb, Px));
+            vby = VAdd(vby, VMul(imb, Py));
+            wb = VAdd(wb, VMul(iib, VSub(VMul(Rbx[j], Py), VMul(Rby[j], Px))));
+
+            // Friction impulse
+            dvx = VSub(VSub(vbx, VMul(wb, Rby[j])), VSub(vax, VMul(wa, Ray[j])));
+            dvy = VSub(VAdd(vby, VMul(wb, Rbx[j])), VAdd(vay, VMul(wa, Rax[j])));
+            VReal vt = VAdd(VMul(dvx, tx), VMul(dvy, ty));
+            lambda = VMul(VXor(Tm[j], signMask), vt);
+
+            // Coulumb's law, sticking up to the static limit then sliding
+            VReal total = VAdd(Ti[j], lambda);
+            VReal sliding = VGreater(VAndNot(signMask, total), VMul(sf, Ni[j]));
+            VReal slide = VOr(VMul(df, Ni[j]), VAnd(total, signMask));
+            total = VBlend(total, slide, sliding);
+            lambda = VAnd(VSub(total, Ti[j]), valid);
+            Ti[j] = VAdd(Ti[j], lambda);
+            change = VAnd(VDiv(VAndNot(signMask, lambda), Tm[j]), valid);
+            residual = VMax(residual, change);
+
+            Px = VMul(lambda, tx);
+            Py = VMul(lambda, ty);
+            vax = VSub(vax, VMul(ima, Px));
+            vay = VSub(vay, VMul(ima, Py));
+            wa = VSub(wa, VMul(iia, VSub(VMul(Rax[j], Py), VMul(Ray[j], Px))));
+            vbx = VAdd(vbx, VMul(imb, Px));
+            vby = VAdd(vby, VMul(imb, Py));
+            wb = VAdd(wb, VMul(iib, VSub(VMul(Rbx[j], Py), VMul(Rby[j], Px))));
+        }
+
+        VStorePoints(&normalImpulse[p], Ni[0], Ni[1]);
+        VStorePoints(&tangentImpulse[p], Ti[0], Ti[1]);
+
+        // No scatter in AVX2, write the dynamic bodies back one lane at a time
+        Real out[6][simdWidth];
+        VStore(out[0], vax);
+        VStore(out[1], vay);
+        VStore(out[2], wa);
+        VStore(out[3], vbx);
+        VStore(out[4], vby);
+        VStore(out[5], wb);
+        for (int k = 0; k < simdWidth; ++k)
+        {
+            int a = bodyA[c + k];
+            int b = bodyB[c + k];
+            if (a >= 0)
+            {
+                vx[a] = out[0][k];
+                vy[a] = out[1][k];
+                w[a] = out[2][k];
+            }
+            if (b >= 0)
+            {
+                vx[b] = out[3][k];
+                vy[b] = out[4][k];
+                w[b] = out[5][k];
+            }
+        }
+    }
+
+    Real lanes[simdWidth];
+    VStore(lanes, residual);
+    Real result = *std::max_element(lanes, lanes + simdWidth);
+    return std::max(result, Solve(c, end));
+}
+#else
+Real ContactSolver::SolveWide(int begin, int end)
+{
+    return Solve(begin, end);
+}
+#endif
+
+void ContactSolver::SetWide(bool enable)
+{
+    wide = false;
+#ifdef SIMD_X86
+    wide = enable && __builtin_cpu_supports("avx2");
+#endif
+}
@@ -0,0 +1,92 @@
+#ifndef CONTACTSOLVER_H
+#define CONTACTSOLVER_H
+
+#include "precompiled.h"
+
+// Constraints per SolveWide group
+#ifdef SIMD_X86
+const int wideGroupSize = simdWidth;
+#else
+const int wideGroupSize = 4; // SolveWide is Solve here, the size doesn't matter
+#endif
+
+// Structure of arrays the impulse iterations run over. Manifold::Initialize
+// fills one constraint per touching pair with everything that stays fixed
+// for the step, so a pass only reads and writes body velocities.
+//
+// Constraints are numbered by Manifold::constraint, points by
+// 2 * constraint + point. Bodies are numbered by Body::index, the same as
+// their slot in the scene's BodyStore. Statics are left out of the velocity
+// arrays and referenced as -1.
+struct ContactSolver
+{
+    ContactSolver()
+        : wide(false), biasRate(0), massScale(1), impulseScale(0), inv_h(0)
+    {
+    }
+
+    void Resize(int bodyCount, int constraintCount);
+
+    // Copy the velocity and mass of the store's body i in or back out
+    void LoadBody(const BodyStore &store, int i);
+    void StoreBody(BodyStore &store, int i) const;
+
+    // Soft steps move bodies in the arrays, StorePosition applies the
+    // accumulated movement to the store
+    void IntegrateVelocity(int i, Real h);
+    void IntegratePosition(int i, Real h);
+    void StorePosition(BodyStore &store, int i) const;
+
+    // Apply the impulses carried over from the last step to constraints [begin, end)
+    void WarmStart(int begin, int end);
+
+    // One pass over constraints [begin, end), returns the largest velocity change
+    Real Solve(int begin, int end);
+
+    // Same pass simdWidth constraints at a time in AVX2 lanes, four doubles
+    // or eight floats. No two constraints in a group starting at
+    // begin + k * simdWidth may share a dynamic body, a colored range always
+    // qualifies. Leftover constraints go through Solve.
+    Real SolveWide(int begin, int end);
+
+    // Call SolveWide instead of Solve on colored constraints and on the
+    // groups the scene packs for every other island, only takes effect when
+    // the CPU supports AVX2
+    void SetWide(bool enable);
+    bool wide;
+
+    // Soft contact springs for substeps of length h
+    void SetSoftness(Real h);
+
+    // One substep pass over constraints [begin, end). With useBias contacts
+    // push apart softly by how deep they are after the bodies' movement this
+    // step, without it the pass only removes approaching velocity.
+    Real SolveSoft(int begin, int end, bool useBias);
+
+    // Bounce once the soft substeps are done, toward the bias Initialize set
+    void ApplyRestitution(int begin, int end);
+
+    Real biasRate, massScale, impulseScale, inv_h;
+
+    // Per body
+    std::vector<Real> vx, vy, w;
+    std::vector<Real> im, iI;
+    std::vector<Real> ax, ay, aw; // Acceleration from gravity and forces
+    std::vector<Real> dx, dy, dq; // Movement since the start of the step
+
+    // Per constraint
+    std::vector<int> contact; // Index into Scene::contacts
+    std::vector<int> bodyA, bodyB;
+    std::vector<int> pointCount;
+    std::vector<Real> nx, ny;               // Normal, the tangent is (ny, -nx)
+    std::vector<Real> staticFriction, dynamicFriction;
+
+    // Per point
+    std::vector<Real> rax, ray, rbx, rby;   // Anchors from each center of mass
+    std::vector<Real> normalMass, tangentMass;
+    std::vector<Real> bias;                 // Target normal velocity from restitution
+    std::vector<Real> separation;           // Negative penetration the narrowphase found
+    std::vector<Real> normalImpulse, tangentImpulse;
+};
+
+#endif // CONTACTSOLVER_H
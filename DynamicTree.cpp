@@ -0,0 +1,302 @@
+#include "precompiled.h"
+
+DynamicTree::DynamicTree()
+    : m_root(NullNode), m_freeList(NullNode), m_proxyCount(0)
+{
+}
+
+int DynamicTree::AllocateNode(void)
+{
+    // Grow the node pool, chaining the new nodes onto the free list
+    if (m_freeList == NullNode)
+    {
+        int count = m_nodes.size();
+        int capacity = std::max(16, count * 2);
+        m_nodes.resize(capacity);
+        for (int i = count; i < capacity; ++i)
+        {
+            m_nodes[i].next = i + 1 < capacity ? i + 1 : NullNode;
+            m_nodes[i].height = -1;
+        }
+        m_freeList = count;
+    }
+
+    int index = m_freeList;
+    Node &node = m_nodes[index];
+    m_freeList = node.next;
+    node.parent = NullNode;
+    node.child1 = NullNode;
+    node.child2 = NullNode;
+    node.height = 0;
+    node.userData = NULL;
+    return index;
+}
+
+void DynamicTree::FreeNode(int index)
+{
+    m_nodes[index].next = m_freeList;
+    m_nodes[index].height = -1;
+    m_freeList = index;
+}
+
+int DynamicTree::CreateProxy(const AABB &aabb, void *userData)
+{
+    int proxyId = AllocateNode();
+    m_nodes[proxyId].aabb = aabb;
+    m_nodes[proxyId].userData = userData;
+    InsertLeaf(proxyId);
+    ++m_proxyCount;
+    return proxyId;
+}
+
+void DynamicTree::DestroyProxy(int proxyId)
+{
+    assert(m_nodes[proxyId].IsLeaf());
+    RemoveLeaf(proxyId);
+    FreeNode(proxyId);
+    --m_proxyCount;
+}
+
+void DynamicTree::MoveProxy(int proxyId, const AABB &aabb)
+{
+    assert(m_nodes[proxyId].IsLeaf());
+    RemoveLeaf(proxyId);
+    m_nodes[proxyId].aabb = aabb;
+    InsertLeaf(proxyId);
+}
+
+void DynamicTree::InsertLeaf(int leaf)
+{
+    if (m_root == NullNode)
+    {
+        m_root = leaf;
+        m_nodes[leaf].parent = NullNode;
+        return;
+    }
+
+    // Walk down to the best sibling, using the increase in perimeter as cost
+    AABB leafAABB = m_nodes[leaf].aabb;
+    int index = m_root;
+    while (!m_nodes[index].IsLeaf())
+    {
+        int child1 = m_nodes[index].child1;
+        int child2 = m_nodes[index].child2;
+
+        Real area = m_nodes[index].aabb.Perimeter();
+        Real combinedArea = Combine(m_nodes[index].aabb, leafAABB).Perimeter();
+
+        // Cost of making a new parent for this node and the new leaf
+        Real cost = 2.0 * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        Real inheritanceCost = 2.0 * (combinedArea - area);
+
+        Real cost1 = Combine(leafAABB, m_nodes[child1].aabb).Perimeter() + inheritanceCost;
+        if (!m_nodes[child1].IsLeaf())
+            cost1 -= m_nodes[child1].aabb.Perimeter();
+
+        Real cost2 = Combine(leafAABB, m_nodes[child2].aabb).Perimeter() + inheritanceCost;
+        if (!m_nodes[child2].IsLeaf())
+            cost2 -= m_nodes[child2].aabb.Perimeter();
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    int sibling = index;
+
+    // Create a new parent holding the sibling and the leaf
+    int oldParent = m_nodes[sibling].parent;
+    int newParent = AllocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].aabb = Combine(leafAABB, m_nodes[sibling].aabb);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent != NullNode)
+    {
+        if (m_nodes[oldParent].child1 == sibling)
+            m_nodes[oldParent].child1 = newParent;
+        else
+            m_nodes[oldParent].child2 = newParent;
+    }
+    else
+        m_root = newParent;
+
+    // Refit and rebalance the ancestors
+    index = m_nodes[leaf].parent;
+    while (index != NullNode)
+    {
+        index = Balance(index);
+
+        int child1 = m_nodes[index].child1;
+        int child2 = m_nodes[index].child2;
+        m_nodes[index].height = 1 + std::max(m_nodes[child1].height, m_nodes[child2].height);
+        m_nodes[index].aabb = Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+
+        index = m_nodes[index].parent;
+    }
+}
+
+void DynamicTree::RemoveLeaf(int leaf)
+{
+    if (leaf == m_root)
+    {
+        m_root = NullNode;
+        return;
+    }
+
+    int parent = m_nodes[leaf].parent;
+    int grandParent = m_nodes[parent].parent;
+    int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    // The sibling takes the parent's place
+    FreeNode(parent);
+    if (grandParent == NullNode)
+    {
+        m_root = sibling;
+        m_nodes[sibling].parent = NullNode;
+        return;
+    }
+
+    if (m_nodes[grandParent].child1 == parent)
+        m_nodes[grandParent].child1 = sibling;
+    else
+        m_nodes[grandParent].child2 = sibling;
+    m_nodes[sibling].parent = grandParent;
+
+    int index = grandParent;
+    while (index != NullNode)
+    {
+        index = Balance(index);
+
+        int child1 = m_nodes[index].child1;
+        int child2 = m_nodes[index].child2;
+        m_nodes[index].aabb = Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+        m_nodes[index].height = 1 + std::max(m_nodes[child1].height, m_nodes[child2].height);
+
+        index = m_nodes[index].parent;
+    }
+}
+
+// Perform a left or right rotation if node A is imbalanced, returns the new
+// root of the subtree. A has children B and C, B has children D and E, C has
+// children F and G.
+int DynamicTree::Balance(int iA)
+{
+    Node *A = &m_nodes[iA];
+    if (A->IsLeaf() || A->height < 2)
+        return iA;
+
+    int iB = A->child1;
+    int iC = A->child2;
+    Node *B = &m_nodes[iB];
+    Node *C = &m_nodes[iC];
+
+    int balance = C->height - B->height;
+
+    // Rotate C up
+    if (balance > 1)
+    {
+        int iF = C->child1;
+        int iG = C->child2;
+        Node *F = &m_nodes[iF];
+        Node *G = &m_nodes[iG];
+
+        // Swap A and C
+        C->child1 = iA;
+        C->parent = A->parent;
+        A->parent = iC;
+
+        // A's old parent should point to C
+        if (C->parent != NullNode)
+        {
+            if (m_nodes[C->parent].child1 == iA)
+                m_nodes[C->parent].child1 = iC;
+            else
+                m_nodes[C->parent].child2 = iC;
+        }
+        else
+            m_root = iC;
+
+        // Rotate the taller of F and G up next to A
+        if (F->height > G->height)
+        {
+            C->child2 = iF;
+            A->child2 = iG;
+            G->parent = iA;
+            A->aabb = Combine(B->aabb, G->aabb);
+            C->aabb = Combine(A->aabb, F->aabb);
+            A->height = 1 + std::max(B->height, G->height);
+            C->height = 1 + std::max(A->height, F->height);
+        }
+        else
+        {
+            C->child2 = iG;
+            A->child2 = iF;
+            F->parent = iA;
+            A->aabb = Combine(B->aabb, F->aabb);
+            C->aabb = Combine(A->aabb, G->aabb);
+            A->height = 1 + std::max(B->height, F->height);
+            C->height = 1 + std::max(A->height, G->height);
+        }
+
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1)
+    {
+        int iD = B->child1;
+        int iE = B->child2;
+        Node *D = &m_nodes[iD];
+        Node *E = &m_nodes[iE];
+
+        // Swap A and B
+        B->child1 = iA;
+        B->parent = A->parent;
+        A->parent = iB;
+
+        // A's old parent should point to B
+        if (B->parent != NullNode)
+        {
+            if (m_nodes[B->parent].child1 == iA)
+                m_nodes[B->parent].child1 = iB;
+            else
+                m_nodes[B->parent].child2 = iB;
+        }
+        else
+            m_root = iB;
+
+        // Rotate the taller of D and E up next to A
+        if (D->height > E->height)
+        {
+            B->child2 = iD;
+            A->child1 = iE;
+            E->parent = iA;
+            A->aabb = Combine(C->aabb, E->aabb);
+            B->aabb = Combine(A->aabb, D->aabb);
+            A->height = 1 + std::max(C->height, E->height);
+            B->height = 1 + std::max(A->height, D->height);
+        }
+        else
+        {
+            B->child2 = iE;
+            A->child1 = iD;
+            D->parent = iA;
+            A->aabb = Combine(C->aabb, D->aabb);
+            B->aabb = Combine(A->aabb, E->aabb);
+            A->height = 1 + std::max(C->height, D->height);
+            B->height = 1 + std::max(A->height, E->height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
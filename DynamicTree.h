@@ -0,0 +1,111 @@
+#ifndef DYNAMICTREE_H
+#define DYNAMICTREE_H
+
+#include "PMath.h"
+
+// Bounding volume hierarchy over AABBs. Leaves are proxies holding user data,
+// internal nodes are kept balanced with tree rotations as leaves come and go.
+// Based on the dynamic tree from Box2D (Erin Catto).
+struct DynamicTree
+{
+    static const int NullNode = -1;
+
+    DynamicTree();
+
+    // Returns a proxy id that stays valid until DestroyProxy
+    int CreateProxy(const AABB &aabb, void *userData);
+    void DestroyProxy(int proxyId);
+
+    // Replace the bounds stored for a proxy, reinserting its leaf
+    void MoveProxy(int proxyId, const AABB &aabb);
+
+    const AABB &GetAABB(int proxyId) const
+    {
+        return m_nodes[proxyId].aabb;
+    }
+
+    void *GetUserData(int proxyId) const
+    {
+        return m_nodes[proxyId].userData;
+    }
+
+    // Calls callback(proxyId) for every leaf overlapping aabb. The query stops
+    // early if the callback returns false.
+    template <typename T>
+    void Query(const AABB &aabb, T &callback) const;
+
+    int GetHeight(void) const
+    {
+        return m_root == NullNode ? 0 : m_nodes[m_root].height;
+    }
+
+    int GetProxyCount(void) const
+    {
+        return m_proxyCount;
+    }
+
+private:
+    struct Node
+    {
+        bool IsLeaf(void) const
+        {
+            return child1 == NullNode;
+        }
+
+        AABB aabb;
+        void *userData;
+        union
+        {
+            int parent;
+            int next; // Free list link
+        };
+        int child1;
+        int child2;
+        int height; // Leaf = 0, free node = -1
+    };
+
+    int AllocateNode(void);
+    void FreeNode(int node);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    int Balance(int index);
+
+    std::vector<Node> m_nodes;
+    int m_root;
+    int m_freeList;
+    int m_proxyCount;
+    mutable std::vector<int> m_stack;
+};
+
+template <typename T>
+void DynamicTree::Query(const AABB &aabb, T &callback) const
+{
+    if (m_root == NullNode)
+        return;
+
+    m_stack.clear();
+    m_stack.push_back(m_root);
+
+    while (!m_stack.empty())
+    {
+        int index = m_stack.back();
+        m_stack.pop_back();
+
+        const Node &node = m_nodes[index];
+        if (!node.aabb.Overlaps(aabb))
+            continue;
+
+        if (node.IsLeaf())
+        {
+            if (!callback(index))
+                return;
+        }
+        else
+        {
+            m_stack.push_back(node.child1);
+            m_stack.push_back(node.child2);
+        }
+    }
+}
+
+#endif // DYNAMICTREE_H
@@ -0,0 +1,331 @@
+#include "precompiled.h"
+
+// See "Implementing GJK" (Casey Muratori) and "EPA" in Real-Time Collision
+// Detection (Christer Ericson) for the algorithms below
+
+GJKProxy::GJKProxy(Body *b)
+    : body(b), poly(NULL)
+{
+    if (b->shape->GetType() != Shape::eCircle)
+        poly = reinterpret_cast<PolygonShape *>(b->shape);
+}
+
+Vec GJKProxy::Support(const Vec &dir) const
+{
+    if (!poly)
+        return body->Position();
+
+    return poly->WorldVertex(poly->WorldSupportIndex(dir));
+}
+
+static Vec MinkowskiSupport(const GJKProxy &A, const GJKProxy &B, const Vec &dir)
+{
+    return A.Support(dir) - B.Support(-dir);
+}
+
+// Perpendicular of v on the side facing towards
+static Vec PerpendicularTowards(const Vec &v, const Vec &towards)
+{
+    Vec p(-v.y, v.x);
+    return Dot(p, towards) < 0.0 ? -p : p;
+}
+
+bool GJKIntersect(const GJKProxy &A, const GJKProxy &B, Vec *simplex)
+{
+    const int k_maxIterations = 64;
+
+    Vec d = B.body->Position() - A.body->Position();
+    if (d.squared_vec_length() < EPSILON * EPSILON)
+        d.Set(1.0, 0.0);
+
+    // s[count - 1] is always the newest point
+    Vec s[3];
+    int count = 0;
+    s[count++] = MinkowskiSupport(A, B, d);
+    d = -s[0];
+
+    for (int iteration = 0; iteration < k_maxIterations; ++iteration)
+    {
+        // Origin sits on the simplex, the shapes only touch
+        if (d.squared_vec_length() < EPSILON * EPSILON)
+            return false;
+
+        Vec a = MinkowskiSupport(A, B, d);
+
+        // Could not get past the origin, so it is outside the difference
+        if (Dot(a, d) <= 0.0)
+            return false;
+
+        s[count++] = a;
+        Vec ao = -a;
+
+        if (count == 2)
+        {
+            Vec ab = s[0] - a;
+            d = PerpendicularTowards(ab, ao);
+            continue;
+        }
+
+        Vec ab = s[1] - a;
+        Vec ac = s[0] - a;
+        Vec abPerp = PerpendicularTowards(ab, -ac);
+        Vec acPerp = PerpendicularTowards(ac, -ab);
+
+        // Origin beyond edge AB, drop C
+        if (Dot(abPerp, ao) > 0.0)
+        {
+            s[0] = s[1];
+            s[1] = a;
+            count = 2;
+            d = abPerp;
+        }
+
+        // Origin beyond edge AC, drop B
+        else if (Dot(acPerp, ao) > 0.0)
+        {
+            s[1] = a;
+            count = 2;
+            d = acPerp;
+        }
+
+        else
+        {
+            simplex[0] = s[0];
+            simplex[1] = s[1];
+            simplex[2] = s[2];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void EPA(const GJKProxy &A, const GJKProxy &B, const Vec *simplex, Vec *normal, Real *depth)
+{
+    const int k_maxVertices = 64;
+    const Real k_tolerance = 0.001;
+
+    Vec p[k_maxVertices];
+    int count = 3;
+    p[0] = simplex[0];
+    p[1] = simplex[1];
+    p[2] = simplex[2];
+
+    // Keep the polytope counter clockwise so edge normals face outwards
+    if (Cross(p[1] - p[0], p[2] - p[0]) < 0.0)
+        std::swap(p[1], p[2]);
+
+    for (;;)
+    {
+        // Edge of the polytope closest to the origin
+        int bestEdge = 0;
+        Real bestDistance = FLT_MAX;
+        Vec bestNormal(1.0, 0.0);
+        for (int i = 0; i < count; ++i)
+        {
+            int j = i + 1 < count ? i + 1 : 0;
+            Vec e = p[j] - p[i];
+            if (e.squared_vec_length() < EPSILON * EPSILON)
+                continue;
+
+            Vec n(e.y, -e.x);
+            n.Normalize();
+            Real distance = Dot(n, p[i]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                bestEdge = i;
+                bestNormal = n;
+            }
+        }
+
+        // Done once the boundary can't be pushed further out along that edge
+        Vec support = MinkowskiSupport(A, B, bestNormal);
+        if (Dot(support, bestNormal) - bestDistance < k_tolerance || count == k_maxVertices)
+        {
+            *normal = bestNormal;
+            *depth = bestDistance;
+            return;
+        }
+
+        for (int i = count; i > bestEdge + 1; --i)
+            p[i] = p[i - 1];
+        p[bestEdge + 1] = support;
+        ++count;
+    }
+}
+
+bool GJKClosestPoint(const GJKProxy &B, const Vec &point, Vec *closest)
+{
+    const int k_maxIterations = 64;
+    const Real k_relativeTolerance = 1e-9;
+
+    // Work on B - point and find the point closest to the origin
+    Vec s[3];
+    int count = 1;
+    s[0] = B.Support(point - B.body->Position()) - point;
+    Vec v = s[0];
+
+    for (int iteration = 0; iteration < k_maxIterations; ++iteration)
+    {
+        Real vv = v.squared_vec_length();
+        if (vv < EPSILON * EPSILON)
+            return false;
+
+        Vec w = B.Support(-v) - point;
+
+        // No support point gets meaningfully closer, v is the answer
+        if (vv - Dot(v, w) <= k_relativeTolerance * vv)
+            break;
+
+        s[count++] = w;
+
+        if (count == 2)
+        {
+            Vec ab = s[1] - s[0];
+            Real t = Clamp(0.0, 1.0, Dot(-s[0], ab) / ab.squared_vec_length());
+            v = s[0] + t * ab;
+            if (t <= 0.0)
+                count = 1;
+            else if (t >= 1.0)
+            {
+                s[0] = s[1];
+                count = 1;
+            }
+            continue;
+        }
+
+        // Triangle, the origin inside means the point is inside B
+        Real c0 = Cross(s[1] - s[0], -s[0]);
+        Real c1 = Cross(s[2] - s[1], -s[1]);
+        Real c2 = Cross(s[0] - s[2], -s[2]);
+        if ((c0 >= 0.0 && c1 >= 0.0 && c2 >= 0.0) || (c0 <= 0.0 && c1 <= 0.0 && c2 <= 0.0))
+            return false;
+
+        // Otherwise keep the closest edge
+        Real best = FLT_MAX;
+        Vec keep[2];
+        for (int i = 0; i < 3; ++i)
+        {
+            Vec a = s[i];
+            Vec b = s[i + 1 < 3 ? i + 1 : 0];
+            Vec ab = b - a;
+            Real t = Clamp(0.0, 1.0, Dot(-a, ab) / ab.squared_vec_length());
+            Vec c = a + t * ab;
+            if (c.squared_vec_length() < best)
+            {
+                best = c.squared_vec_length();
+                v = c;
+                keep[0] = a;
+                keep[1] = b;
+            }
+        }
+        s[0] = keep[0];
+        s[1] = keep[1];
+        count = 2;
+    }
+
+    *closest = v + point;
+    return true;
+}
+
+void CircletoHull(Manifold *m, Body *a, Body *b)
+{
+    Circle *A = reinterpret_cast<Circle *>(a->shape);
+    GJKProxy hull(b);
+    m->contact_count = 0;
+
+    Vec closest;
+    if (GJKClosestPoint(hull, a->Position(), &closest))
+    {
+        Vec n = closest - a->Position();
+        Real dist_sqr = n.squared_vec_length();
+        if (dist_sqr >= A->radius * A->radius)
+            return;
+
+        Real distance = std::sqrt(dist_sqr);
+        m->contact_count = 1;
+        m->normal = n / distance;
+        m->penetration = A->radius - distance;
+        m->contacts[0] = closest;
+        return;
+    }
+
+    // Center is inside the hull, push out through the nearest face
+    GJKProxy center(a);
+    Vec simplex[3];
+    m->contact_count = 1;
+    if (!GJKIntersect(center, hull, simplex))
+    {
+        // Center sits right on the boundary
+        m->normal = b->Position() - a->Position();
+        m->normal.Normalize();
+        m->penetration = A->radius;
+        m->contacts[0] = a->Position();
+        return;
+    }
+
+    Vec n;
+    Real depth;
+    EPA(center, hull, simplex, &n, &depth);
+    m->normal = n;
+    m->penetration = A->radius + depth;
+    m->contacts[0] = a->Position() - n * depth;
+}
+
+void HulltoCircle(Manifold *m, Body *a, Body *b)
+{
+    CircletoHull(m, b, a);
+    m->normal = -m->normal;
+}
+
+// Any pair of polygons where at least one is a large hull. GJK/EPA finds the
+// normal, then the faces best aligned with it are clipped like the SAT path.
+void ConvextoConvex(Manifold *m, Body *a, Body *b)
+{
+    PolygonShape *A = reinterpret_cast<PolygonShape *>(a->shape);
+    PolygonShape *B = reinterpret_cast<PolygonShape *>(b->shape);
+    GJKProxy pa(a);
+    GJKProxy pb(b);
+    m->contact_count = 0;
+
+    Vec simplex[3];
+    if (!GJKIntersect(pa, pb, simplex))
+        return;
+
+    Vec n;
+    Real depth;
+    EPA(pa, pb, simplex, &n, &depth);
+
+    // Reference face is the one most parallel to the normal
+    int faceA = A->BestFace(A->u.Transpose() * n);
+    int faceB = B->BestFace(B->u.Transpose() * -n);
+    Real alignA = Dot(A->WorldNormal(faceA), n);
+    Real alignB = Dot(B->WorldNormal(faceB), -n);
+
+    PolygonShape *RefPoly = A;
+    PolygonShape *IncPoly = B;
+    int referenceIndex = faceA;
+    bool flip = false;
+    if (!BiasGreaterThan(alignA, alignB))
+    {
+        RefPoly = B;
+        IncPoly = A;
+        referenceIndex = faceB;
+        flip = true;
+    }
+
+    Vec refNormal = RefPoly->WorldNormal(referenceIndex);
+    int incidentIndex = IncPoly->BestFace(IncPoly->u.Transpose() * -refNormal);
+    ClipReferenceFace(m, RefPoly, IncPoly, referenceIndex, incidentIndex, flip);
+
+    // Clipping can lose both points on near degenerate overlaps, fall back
+    // to the single deepest point
+    if (m->contact_count == 0)
+    {
+        m->contact_count = 1;
+        m->normal = n;
+        m->penetration = depth;
+        m->contacts[0] = pb.Support(-n);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef GJK_H
+#define GJK_H
+
+#include "PMath.h"
+struct Body;
+struct PolygonShape;
+
+// World space support mapping of a body's core shape. Circles reduce to
+// their center point, callers add the radius back.
+struct GJKProxy
+{
+    GJKProxy(Body *b);
+
+    Vec Support(const Vec &dir) const;
+
+    Body *body;
+    PolygonShape *poly; // NULL for circles
+};
+
+// True if A and B overlap, simplex is then a triangle of points on the
+// Minkowski difference A - B enclosing the origin
+bool GJKIntersect(const GJKProxy &A, const GJKProxy &B, Vec *simplex);
+
+// Penetration depth and normal (from A to B) of overlapping shapes, expanding
+// the simplex found by GJKIntersect
+void EPA(const GJKProxy &A, const GJKProxy &B, const Vec *simplex, Vec *normal, Real *depth);
+
+// Closest point of B to point, false if point is inside B
+bool GJKClosestPoint(const GJKProxy &B, const Vec &point, Vec *closest);
+
+#endif // GJK_H
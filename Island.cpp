@@ -0,0 +1,124 @@
+#include "precompiled.h"
+
+void UnionFind::Reset(int count)
+{
+    parent.resize(count);
+    for (int i = 0; i < count; ++i)
+        parent[i] = i;
+}
+
+int UnionFind::Find(int i)
+{
+    while (parent[i] != i)
+    {
+        // Path halving
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+void UnionFind::Union(int i, int j)
+{
+    i = Find(i);
+    j = Find(j);
+    if (i == j)
+        return;
+
+    // Lower slot wins so islands come out in body order
+    if (i < j)
+        parent[j] = i;
+    else
+        parent[i] = j;
+}
+
+void ConstraintColoring::Build(const Island &island, const std::vector<Manifold> &contacts, std::vector<unsigned> &masks)
+{
+    for (int i = 0; i < maxColors; ++i)
+        colors[i].clear();
+    overflow.clear();
+
+    for (int i = 0; i < island.bodies.size(); ++i)
+        masks[island.bodies[i]] = 0;
+
+    // First free color of both bodies, in contact order so the result never
+    // depends on the thread count
+    colorCount = 0;
+    for (int i = 0; i < island.contacts.size(); ++i)
+    {
+        int k = island.contacts[i];
+        const Manifold &m = contacts[k];
+        unsigned used = 0;
+        if (m.A->im != 0)
+            used |= masks[m.A->index];
+        if (m.B->im != 0)
+            used |= masks[m.B->index];
+
+        if (used == ~0u)
+        {
+            overflow.push_back(k);
+            continue;
+        }
+
+        int color = __builtin_ctz(~used);
+        colors[color].push_back(k);
+        colorCount = std::max(colorCount, color + 1);
+        if (m.A->im != 0)
+            masks[m.A->index] |= 1u << color;
+        if (m.B->im != 0)
+            masks[m.B->index] |= 1u << color;
+    }
+}
+
+void WidePacking::Build(const Island &island, const std::vector<Manifold> &contacts, std::vector<unsigned> &masks, int width)
+{
+    grouped.clear();
+    rest.clear();
+    for (int i = 0; i < maxColors; ++i)
+        m_open[i].clear();
+
+    for (int i = 0; i < island.bodies.size(); ++i)
+        masks[island.bodies[i]] = 0;
+
+    for (int i = 0; i < island.contacts.size(); ++i)
+    {
+        int k = island.contacts[i];
+        const Manifold &m = contacts[k];
+        unsigned used = 0;
+        if (m.A->im != 0)
+            used |= masks[m.A->index];
+        if (m.B->im != 0)
+            used |= masks[m.B->index];
+
+        if (used == ~0u)
+        {
+            rest.push_back(k);
+            continue;
+        }
+
+        int g = __builtin_ctz(~used);
+        std::vector<int> &group = m_open[g];
+        group.push_back(k);
+        if (m.A->im != 0)
+            masks[m.A->index] |= 1u << g;
+        if (m.B->im != 0)
+            masks[m.B->index] |= 1u << g;
+        if (group.size() < width)
+            continue;
+
+        // Full, its bodies are free for the next group on this bit
+        for (int j = 0; j < group.size(); ++j)
+        {
+            const Manifold &n = contacts[group[j]];
+            if (n.A->im != 0)
+                masks[n.A->index] &= ~(1u << g);
+            if (n.B->im != 0)
+                masks[n.B->index] &= ~(1u << g);
+        }
+        grouped.insert(grouped.end(), group.begin(), group.end());
+        group.clear();
+    }
+
+    for (int i = 0; i < maxColors; ++i)
+        rest.insert(rest.end(), m_open[i].begin(), m_open[i].end());
+}
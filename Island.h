@@ -0,0 +1,66 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include "precompiled.h"
+
+// Disjoint sets over body slots, joined by contacts each step
+struct UnionFind
+{
+    void Reset(int count);
+    int Find(int i);
+    void Union(int i, int j);
+
+    std::vector<int> parent;
+};
+
+// Awake bodies linked through contacts. Statics never join two islands.
+struct Island
+{
+    std::vector<int> bodies;   // Slots in Scene::bodies
+    std::vector<int> contacts; // Indices into Scene::contacts
+    int firstConstraint;       // The island's contacts own a run of solver constraints
+    int groupedEnd;            // [firstConstraint, groupedEnd) is packed into SolveWide groups
+
+    // Solver passes this island needed and its final residual
+    int iterations;
+    Real residual;
+};
+
+// An island put to sleep keeps its contacts, nothing about them changes
+// until one of its bodies is touched again
+struct SleepingIsland
+{
+    std::vector<Body *> bodies;
+    std::vector<Manifold> contacts;
+};
+
+// Colors a large island's contacts so that no two contacts of one color
+// share a dynamic body. Statics never conflict.
+const int maxColors = 32;
+
+struct ConstraintColoring
+{
+    // contacts are Scene::contacts, masks is scratch indexed by Body::index
+    void Build(const Island &island, const std::vector<Manifold> &contacts, std::vector<unsigned> &masks);
+
+    int colorCount;
+    std::vector<int> colors[maxColors]; // Indices into Scene::contacts
+    std::vector<int> overflow;          // Contacts no color was free for, solved serially
+};
+
+// Packs an island's contacts into groups of width with no dynamic body
+// twice in a group, so SolveWide can take them a group at a time without
+// coloring the island. Up to maxColors groups fill at once, each holding a
+// bit in masks until it is full.
+struct WidePacking
+{
+    void Build(const Island &island, const std::vector<Manifold> &contacts, std::vector<unsigned> &masks, int width);
+
+    std::vector<int> grouped; // Whole groups, width contacts each
+    std::vector<int> rest;    // Contacts no group was completed for
+
+private:
+    std::vector<int> m_open[maxColors];
+};
+
+#endif // ISLAND_H
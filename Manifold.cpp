@@ -5,7 +5,7 @@ void Manifold::Solve(void)
   Dispatch[A->shape->GetType()][B->shape->GetType()](this, A, B);
 }
 
-void Manifold::Initialize(void)
+void Manifold::Initialize(ContactSolver *solver, Real dt)
 {
   // Calculate average restitution
   e = std::min(A->restitution, B->restitution);
@@ -14,107 +14,79 @@ void Manifold::Initialize(void)
   sf = std::sqrt(A->staticFriction * B->staticFriction);
   df = std::sqrt(A->dynamicFriction * B->dynamicFriction);
 
+  int c = constraint;
+  solver->bodyA[c] = A->im != 0 ? A->index : -1;
+  solver->bodyB[c] = B->im != 0 ? B->index : -1;
+  solver->pointCount[c] = contact_count;
+  solver->nx[c] = normal.x;
+  solver->ny[c] = normal.y;
+  solver->staticFriction[c] = sf;
+  solver->dynamicFriction[c] = df;
+
+  Vec tangent = Cross(normal, 1.0);
+
   for (int i = 0; i < contact_count; ++i)
   {
+    int p = 2 * c + i;
+
     // Calculate radii from COM to contact
-    Vec ra = contacts[i] - A->position;
-    Vec rb = contacts[i] - B->position;
+    Vec ra = contacts[i] - A->Position();
+    Vec rb = contacts[i] - B->Position();
+    solver->rax[p] = ra.x;
+    solver->ray[p] = ra.y;
+    solver->rbx[p] = rb.x;
+    solver->rby[p] = rb.y;
 
-    Vec rv = B->velocity + Cross(B->angularVelocity, rb) -
-             A->velocity - Cross(A->angularVelocity, ra);
+    Real raCrossN = Cross(ra, normal);
+    Real rbCrossN = Cross(rb, normal);
+    solver->normalMass[p] = 1.0 / (A->im + B->im + Sqr(raCrossN) * A->iI + Sqr(rbCrossN) * B->iI);
+
+    Real raCrossT = Cross(ra, tangent);
+    Real rbCrossT = Cross(rb, tangent);
+    solver->tangentMass[p] = 1.0 / (A->im + B->im + Sqr(raCrossT) * A->iI + Sqr(rbCrossT) * B->iI);
+
+    Vec rv = B->Velocity() + Cross(B->AngularVelocity(), rb) -
+             A->Velocity() - Cross(A->AngularVelocity(), ra);
 
     // Determine if we should perform a resting collision or not
     // The idea is if the only thing moving this object is gravity,
-    // then the collision should be performed without any restitution
-    // if (rv.squared_vec_length() < (dt * gravity).squared_vec_length() + EPSILON){
-    //   e = 0.0f;
-    //   std::cout<<"RIP"<<"\n";
-    // }
+    // then the collision should be performed without any restitution.
+    // Points still carrying an impulse from the last step are resting too.
+    Real contactVel = Dot(rv, normal);
+    solver->bias[p] = 0;
+    if (rv.squared_vec_length() > (dt * gravity).squared_vec_length() + EPSILON &&
+        contactVel < 0 && normalImpulse[i] == 0)
+      solver->bias[p] = -e * contactVel;
+
+    // Two points only come from face clipping, which keeps each point's depth
+    solver->separation[p] = contact_count == 2 ? -depth[i] : -penetration;
+    solver->normalImpulse[p] = normalImpulse[i];
+    solver->tangentImpulse[p] = tangentImpulse[i];
   }
 }
 
-void Manifold::ApplyImpulse(void)
+void Manifold::ReadImpulses(const ContactSolver *solver)
 {
-  // Early out and positional correct if both objects have infinite mass
-  if (Equal(A->im + B->im, 0))
-  {
-    std::cout<<A->im<<" "<<B->im<<"\n";
-    InfiniteMassCorrection();
-    std::cout<<"Hello\n";
-    return;
-  }
-
   for (int i = 0; i < contact_count; ++i)
   {
-    // Calculate radii from COM to contact
-    Vec ra = contacts[i] - A->position;
-    Vec rb = contacts[i] - B->position;
-
-    // Relative velocity
-    Vec rv = B->velocity + Cross(B->angularVelocity, rb) -
-             A->velocity - Cross(A->angularVelocity, ra);
-
-    // Relative velocity along the normal
-    double contactVel = Dot(rv, normal);
-
-    // Do not resolve if velocities are separating
-    if (contactVel > 0)
-      return;
-
-    double raCrossN = Cross(ra, normal);
-    double rbCrossN = Cross(rb, normal);
-    double invMassSum = A->im + B->im + Sqr(raCrossN) * A->iI + Sqr(rbCrossN) * B->iI;
-
-    // Calculate impulse scalar
-    double j = -(1.0f + e) * contactVel;
-    j /= invMassSum;
-    j /= (double)contact_count;
-
-    // Apply impulse
-    Vec impulse = normal * j;
-    A->ApplyImpulse(-impulse, ra);
-    B->ApplyImpulse(impulse, rb);
-
-    // Friction impulse
-    rv = B->velocity + Cross(B->angularVelocity, rb) -
-         A->velocity - Cross(A->angularVelocity, ra);
-
-    Vec t = rv - (normal * Dot(rv, normal));
-    t.Normalize();
-
-    // j tangent magnitude
-    double jt = -Dot(rv, t);
-    jt /= invMassSum;
-    jt /= (double)contact_count;
-
-    // Don't apply tiny friction impulses
-    if (Equal(jt, 0.0f))
-      return;
-
-    // Coulumb's law
-    Vec tangentImpulse;
-    if (std::abs(jt) < j * sf)
-      tangentImpulse = t * jt;
-    else
-      tangentImpulse = t * -j * df;
-
-    // Apply friction impulse
-    A->ApplyImpulse(-tangentImpulse, ra);
-    B->ApplyImpulse(tangentImpulse, rb);
+    normalImpulse[i] = solver->normalImpulse[2 * constraint + i];
+    tangentImpulse[i] = solver->tangentImpulse[2 * constraint + i];
   }
 }
 
 void Manifold::PositionalCorrection(void)
 {
-  const double k_slop = 0.05f; // Penetration allowance
-  const double percent = 0.4f; // Penetration percentage to correct
-  Vec correction = (std::max(penetration - k_slop, 0.0) / (A->im + B->im)) * normal * percent;
-  A->position -= correction * A->im;
-  B->position += correction * B->im;
+  const Real k_slop = 0.05f; // Penetration allowance
+  const Real percent = 0.4f; // Penetration percentage to correct
+  Vec correction = (std::max(penetration - k_slop, Real(0)) / (A->im + B->im)) * normal * percent;
+  if (A->im != 0)
+    A->Position() -= correction * A->im;
+  if (B->im != 0)
+    B->Position() += correction * B->im;
 }
 
 void Manifold::InfiniteMassCorrection(void)
 {
-  A->velocity.Set(0, 0);
-  B->velocity.Set(0, 0);
+  A->Velocity().Set(0, 0);
+  B->Velocity().Set(0, 0);
 }
@@ -3,31 +3,47 @@
 
 #include "PMath.h"
 struct Body;
+struct SATCache;
+struct ContactSolver;
 
 struct Manifold
 {
   Manifold( Body *a, Body *b )
     : A( a )
     , B( b )
+    , contact_count( 0 )
+    , sat( NULL )
+    , constraint( -1 )
   {
+    features[0] = features[1] = 0;
+    normalImpulse[0] = normalImpulse[1] = 0;
+    tangentImpulse[0] = tangentImpulse[1] = 0;
   }
 
   void Solve( void );                 // Generate contact information
-  void Initialize( void );            // Precalculations for impulse solving
-  void ApplyImpulse( void );          // Solve impulse and apply
+  void Initialize( ContactSolver *solver, Real dt ); // Fill this pair's constraint for impulse solving
+  void ReadImpulses( const ContactSolver *solver ); // Keep the solved impulses for the next step
   void PositionalCorrection( void );  // Naive correction of positional penetration
   void InfiniteMassCorrection( void );
 
   Body *A;
   Body *B;
 
-  double penetration;     // Depth of penetration from collision
+  Real penetration;       // Depth of penetration from collision
   Vec normal;          // From A to B
   Vec contacts[2];     // Points of contact during collision
   int contact_count; // Number of contacts that occured during collision
-  double e;               // Mixed restitution
-  double df;              // Mixed dynamic friction
-  double sf;              // Mixed static friction
+  Real depth[2];          // Per point penetration, only kept for two point manifolds
+  unsigned features[2]; // Identifies each contact point from step to step
+  Real e;                 // Mixed restitution
+  Real df;                // Mixed dynamic friction
+  Real sf;                // Mixed static friction
+  SATCache *sat;          // Persistent polygon axis cache, may be NULL
+  int constraint;         // Slot in the scene's ContactSolver
+
+  // Accumulated impulses per contact point, seeded from the last step
+  Real normalImpulse[2];
+  Real tangentImpulse[2];
 };
 
 #endif // MANIFOLD_H
\ No newline at end of file
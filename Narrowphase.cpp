@@ -0,0 +1,131 @@
+#include "precompiled.h"
+
+template <CollisionCallback Callback>
+void Narrowphase::Kernel(const std::vector<BodyPair> &pairs, const std::vector<int> &bucket)
+{
+    for (int k = 0; k < bucket.size(); ++k)
+    {
+        int i = bucket[k];
+        Manifold &m = m_results[i];
+        Callback(&m, m.A, m.B);
+    }
+}
+
+void Narrowphase::CircleCircleKernel(const std::vector<BodyPair> &pairs, const std::vector<int> &bucket)
+{
+    int count = bucket.size();
+    if (!count)
+        return;
+
+    m_ia.resize(count);
+    m_ib.resize(count);
+    m_hit.resize(count);
+    m_penetration.resize(count);
+    m_nx.resize(count);
+    m_ny.resize(count);
+    m_cx.resize(count);
+    m_cy.resize(count);
+
+    for (int k = 0; k < count; ++k)
+    {
+        const BodyPair &p = pairs[bucket[k]];
+        m_ia[k] = p.A->index;
+        m_ib[k] = p.B->index;
+    }
+
+    circleContacts(&x[0], &y[0], &radius[0], &m_ia[0], &m_ib[0], count,
+                   &m_penetration[0], &m_nx[0], &m_ny[0], &m_cx[0], &m_cy[0], &m_hit[0]);
+
+    for (int k = 0; k < count; ++k)
+    {
+        if (!m_hit[k])
+            continue;
+
+        Manifold &m = m_results[bucket[k]];
+        m.contact_count = 1;
+        m.penetration = m_penetration[k];
+        m.normal.Set(m_nx[k], m_ny[k]);
+        m.contacts[0].Set(m_cx[k], m_cy[k]);
+    }
+}
+
+void Narrowphase::PolygonPolygonKernel(const std::vector<BodyPair> &pairs, const std::vector<int> &bucket)
+{
+    for (int k = 0; k < bucket.size(); ++k)
+    {
+        int i = bucket[k];
+        Manifold &m = m_results[i];
+        SATCache &cache = satCache[PairKey(pairs[i])];
+        cache.step = m_step;
+        m.sat = &cache;
+        PolygontoPolygon(&m, m.A, m.B);
+    }
+
+    // Forget axes of pairs the broadphase no longer reports
+    for (auto it = satCache.begin(); it != satCache.end();)
+    {
+        if (it->second.step != m_step)
+            it = satCache.erase(it);
+        else
+            ++it;
+    }
+}
+
+void Narrowphase::UpdateBodies(const BodyStore &bodies, const BodyStore &statics)
+{
+    int count = bodies.Count() + statics.Count();
+    x.resize(count);
+    y.resize(count);
+    radius.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        bool dynamic = i < bodies.Count();
+        const BodyStore &store = dynamic ? bodies : statics;
+        int slot = dynamic ? i : i - bodies.Count();
+        Body *b = store.records[slot];
+        b->index = i;
+        x[i] = store.position[slot].x;
+        y[i] = store.position[slot].y;
+        radius[i] = b->shapeType == Shape::eCircle ? b->shape->radius : 0.0;
+    }
+}
+
+void Narrowphase::Collide(const std::vector<BodyPair> &pairs, std::vector<Manifold> &contacts)
+{
+    ++m_step;
+
+    // Bucket by shape type pair
+    for (int i = 0; i < Shape::eCount; ++i)
+        for (int j = 0; j < Shape::eCount; ++j)
+            m_buckets[i][j].clear();
+
+    m_results.assign(pairs.size(), Manifold(NULL, NULL));
+    for (int i = 0; i < pairs.size(); ++i)
+    {
+        const BodyPair &p = pairs[i];
+        m_results[i].A = p.A;
+        m_results[i].B = p.B;
+        m_buckets[p.A->shapeType][p.B->shapeType].push_back(i);
+    }
+
+    CircleCircleKernel(pairs, m_buckets[Shape::eCircle][Shape::eCircle]);
+    Kernel<CircletoPolygon>(pairs, m_buckets[Shape::eCircle][Shape::ePoly]);
+    Kernel<CircletoHull>(pairs, m_buckets[Shape::eCircle][Shape::eHull]);
+    Kernel<PolygontoCircle>(pairs, m_buckets[Shape::ePoly][Shape::eCircle]);
+    PolygonPolygonKernel(pairs, m_buckets[Shape::ePoly][Shape::ePoly]);
+    Kernel<ConvextoConvex>(pairs, m_buckets[Shape::ePoly][Shape::eHull]);
+    Kernel<HulltoCircle>(pairs, m_buckets[Shape::eHull][Shape::eCircle]);
+    Kernel<ConvextoConvex>(pairs, m_buckets[Shape::eHull][Shape::ePoly]);
+    Kernel<ConvextoConvex>(pairs, m_buckets[Shape::eHull][Shape::eHull]);
+
+    for (int i = 0; i < Shape::eCount; ++i)
+        for (int j = 0; j < Shape::eCount; ++j)
+            bucketSizes[i][j] = m_buckets[i][j].size();
+
+    // Compact touching pairs, keeping candidate pair order
+    contacts.clear();
+    for (int i = 0; i < m_results.size(); ++i)
+        if (m_results[i].contact_count)
+            contacts.push_back(m_results[i]);
+}
@@ -0,0 +1,50 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include "precompiled.h"
+
+// Runs the collision routines over a step's candidate pairs. Pairs are first
+// bucketed by shape type pair, then each bucket is handed to a kernel that
+// calls its routine directly. Contacts come out in candidate pair order.
+struct Narrowphase
+{
+    Narrowphase()
+        : circleContacts(SelectCircleContacts()), m_step(0)
+    {
+    }
+
+    // Number every body (Body::index) and mirror positions and radii
+    void UpdateBodies(const BodyStore &bodies, const BodyStore &statics);
+
+    // Replace contacts with the touching pairs from pairs
+    void Collide(const std::vector<BodyPair> &pairs, std::vector<Manifold> &contacts);
+
+    // Circle-circle batch kernel, picked for the CPU at startup
+    CircleContactsFn circleContacts;
+
+    // Positions and radii by Body::index
+    std::vector<Real> x, y, radius;
+
+    // Polygon pairs remember their last separating axis or reference face
+    std::unordered_map<unsigned long long, SATCache> satCache;
+
+    // Pairs per bucket in the last Collide
+    int bucketSizes[Shape::eCount][Shape::eCount];
+
+private:
+    void CircleCircleKernel(const std::vector<BodyPair> &pairs, const std::vector<int> &bucket);
+    void PolygonPolygonKernel(const std::vector<BodyPair> &pairs, const std::vector<int> &bucket);
+
+    template <CollisionCallback Callback>
+    void Kernel(const std::vector<BodyPair> &pairs, const std::vector<int> &bucket);
+
+    std::vector<int> m_buckets[Shape::eCount][Shape::eCount];
+    std::vector<Manifold> m_results; // Indexed like pairs
+    unsigned m_step;
+
+    // Circle pair batch
+    std::vector<int> m_ia, m_ib, m_hit;
+    std::vector<Real> m_penetration, m_nx, m_ny, m_cx, m_cy;
+};
+
+#endif // NARROWPHASE_H
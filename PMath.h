@@ -4,90 +4,101 @@
 #include <math.h>
 #include <algorithm>
 
-const double PI = 3.141592741;
-const double EPSILON = 0.0001;
-
-struct Vec
+// The engine's scalar. Building with -DPHYSICS_FLOAT halves body, contact
+// and solver memory and doubles the lanes of the AVX2 kernels.
+#ifdef PHYSICS_FLOAT
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
+const Real PI = 3.141592741;
+const Real EPSILON = 0.0001;
+
+template <typename T>
+struct Vec2
 {
-    double x, y;
+    typedef T Scalar;
+
+    T x, y;
 
-    Vec(){};
+    Vec2(){};
 
-    Vec(double X, double Y)
+    Vec2(T X, T Y)
     {
         x = X, y = Y;
     }
 
-    void Set(double X, double Y)
+    void Set(T X, T Y)
     {
         x = X, y = Y;
     }
 
-    Vec operator-(void) const
+    Vec2 operator-(void) const
     {
-        return Vec(-x, -y);
+        return Vec2(-x, -y);
     }
 
-    Vec operator*(double s) const
+    Vec2 operator*(T s) const
     {
-        return Vec(x * s, y * s);
+        return Vec2(x * s, y * s);
     }
 
-    Vec operator/(double s) const
+    Vec2 operator/(T s) const
     {
-        return Vec(x / s, y / s);
+        return Vec2(x / s, y / s);
     }
 
-    void operator*=(double s)
+    void operator*=(T s)
     {
         x *= s;
         y *= s;
     }
 
-    Vec operator+(const Vec &rhs) const
+    Vec2 operator+(const Vec2 &rhs) const
     {
-        return Vec(x + rhs.x, y + rhs.y);
+        return Vec2(x + rhs.x, y + rhs.y);
     }
 
-    Vec operator+(double s) const
+    Vec2 operator+(T s) const
     {
-        return Vec(x + s, y + s);
+        return Vec2(x + s, y + s);
     }
 
-    void operator+=(const Vec &rhs)
+    void operator+=(const Vec2 &rhs)
     {
         x += rhs.x;
         y += rhs.y;
     }
 
-    Vec operator-(const Vec &rhs) const
+    Vec2 operator-(const Vec2 &rhs) const
     {
-        return Vec(x - rhs.x, y - rhs.y);
+        return Vec2(x - rhs.x, y - rhs.y);
     }
 
-    void operator-=(const Vec &rhs)
+    void operator-=(const Vec2 &rhs)
     {
         x -= rhs.x;
         y -= rhs.y;
     }
 
-    double squared_vec_length(void) const
+    T squared_vec_length(void) const
     {
         return x * x + y * y;
     }
 
-    double vect_length(void) const
+    T vect_length(void) const
     {
         return std::sqrt(x * x + y * y);
     }
 
-    void Rotate(double radians)
+    void Rotate(T radians)
     {
-        double c = std::cos(radians);
-        double s = std::sin(radians);
+        T c = std::cos(radians);
+        T s = std::sin(radians);
 
-        double xp = x * c - y * s;
-        double yp = x * s + y * c;
+        T xp = x * c - y * s;
+        T yp = x * s + y * c;
 
         x = xp;
         y = yp;
@@ -95,17 +106,19 @@ struct Vec
 
     void Normalize(void)
     {
-        double len = vect_length();
+        T len = vect_length();
 
         if (len > EPSILON)
         {
-            double invLen = 1.0f / len;
+            T invLen = 1.0f / len;
             x *= invLen;
             y *= invLen;
         }
     }
 };
 
+typedef Vec2<Real> Vec;
+
 inline double Random(double l, double h)
 {
     double a = (double)rand();
@@ -114,42 +127,53 @@ inline double Random(double l, double h)
     return a;
 }
 
-inline Vec operator*(double s, const Vec &v)
+// Scalar arguments next to a vector take the vector's type instead of
+// being deduced, so literals like 1.0 work in float builds
+template <typename T>
+inline Vec2<T> operator*(typename Vec2<T>::Scalar s, const Vec2<T> &v)
 {
-    return Vec(s * v.x, s * v.y);
+    return Vec2<T>(s * v.x, s * v.y);
 }
 
-inline double Cross(const Vec &a, const Vec &b)
+template <typename T>
+inline T Cross(const Vec2<T> &a, const Vec2<T> &b)
 {
     return a.x * b.y - a.y * b.x;
 }
 
-inline Vec Cross(const Vec &v, double a)
+template <typename T>
+inline Vec2<T> Cross(const Vec2<T> &v, typename Vec2<T>::Scalar a)
 {
-    return Vec(a * v.y, -a * v.x);
+    return Vec2<T>(a * v.y, -a * v.x);
 }
 
-inline Vec Cross(double a, const Vec &v)
+template <typename T>
+inline Vec2<T> Cross(typename Vec2<T>::Scalar a, const Vec2<T> &v)
 {
-    return Vec(-a * v.y, a * v.x);
+    return Vec2<T>(-a * v.y, a * v.x);
 }
 
-inline double Dot(const Vec &a, const Vec &b)
+template <typename T>
+inline T Dot(const Vec2<T> &a, const Vec2<T> &b)
 {
     return a.x * b.x + a.y * b.y;
 }
 
-inline double Sqr(double a)
+template <typename T>
+inline T Sqr(T a)
 {
     return a * a;
 }
 
-inline bool Equal(double a, double b)
+template <typename T>
+inline bool Equal(T a, typename Vec2<T>::Scalar b)
 {
     return std::abs(a - b) <= EPSILON;
 }
 
-inline double Clamp(double min, double max, double a)
+// Bounds take a's type
+template <typename T>
+inline T Clamp(typename Vec2<T>::Scalar min, typename Vec2<T>::Scalar max, T a)
 {
     if (a < min)
         return min;
@@ -158,29 +182,86 @@ inline double Clamp(double min, double max, double a)
     return a;
 }
 
-const double gravityScale = 5.0;
+const Real gravityScale = 5.0;
 const Vec gravity(0, 10.0 * gravityScale);
-const double dt = 1.0 / 60.0;
+const Real dt = 1.0 / 60.0;
 
-struct Mat2
+// A body slower than this for timeToSleep seconds may sleep with its island
+const Real linearSleepTolerance = 2.0;   // Pixels per second
+const Real angularSleepTolerance = 0.05; // Radians per second
+const Real timeToSleep = 0.5;
+
+// Orientation kept as the unit complex number c + is. Integrating an
+// angular velocity only needs a multiply and a renormalize, no trig.
+template <typename T>
+struct Rotor2
+{
+    T c, s;
+
+    Rotor2() {}
+    Rotor2(T c_, T s_)
+        : c(c_), s(s_)
+    {
+    }
+
+    explicit Rotor2(T radians)
+        : c(std::cos(radians)), s(std::sin(radians))
+    {
+    }
+
+    T Angle(void) const
+    {
+        return std::atan2(s, c);
+    }
+
+    // Turned further by a small angle, first order like Box2D's IntegrateRotation
+    Rotor2 Integrate(T angle) const
+    {
+        T qc = c - angle * s;
+        T qs = s + angle * c;
+        T inv = 1.0f / std::sqrt(qc * qc + qs * qs);
+        return Rotor2(qc * inv, qs * inv);
+    }
+
+    // Part way to rhs, t in [0, 1]. Normalized lerp, close enough to the
+    // exact slerp for the turn of a single step.
+    Rotor2 Blend(const Rotor2 &rhs, T t) const
+    {
+        T qc = c + (rhs.c - c) * t;
+        T qs = s + (rhs.s - s) * t;
+        T inv = 1.0f / std::sqrt(qc * qc + qs * qs);
+        return Rotor2(qc * inv, qs * inv);
+    }
+
+    // Rotation taking rhs's frame to this one, conj(rhs) * this
+    Rotor2 Relative(const Rotor2 &rhs) const
+    {
+        return Rotor2(rhs.c * c + rhs.s * s, rhs.c * s - rhs.s * c);
+    }
+};
+
+typedef Rotor2<Real> Rotor;
+
+template <typename T>
+struct Mat22
 {
     union
     {
         struct
         {
-            double m00, m01;
-            double m10, m11;
+            T m00, m01;
+            T m10, m11;
         };
 
-        double m[2][2];
-        double v[4];
+        T m[2][2];
+        T v[4];
     };
 
-    Mat2() {}
-    Mat2(double radians)
+    Mat22() {}
+    Mat22(T radians)
     {
-        double c = std::cos(radians);
-        double s = std::sin(radians);
+        T c = std::cos(radians);
+        T s = std::sin(radians);
 
         m00 = c;
         m01 = -s;
@@ -188,15 +269,15 @@ struct Mat2
         m11 = c;
     }
 
-    Mat2(double a, double b, double c, double d)
+    Mat22(T a, T b, T c, T d)
         : m00(a), m01(b), m10(c), m11(d)
     {
     }
 
-    void Set(double radians)
+    void Set(T radians)
     {
-        double c = std::cos(radians);
-        double s = std::sin(radians);
+        T c = std::cos(radians);
+        T s = std::sin(radians);
 
         m00 = c;
         m01 = -s;
@@ -204,37 +285,45 @@ struct Mat2
         m11 = c;
     }
 
-    Mat2 Abs(void) const
+    void Set(const Rotor2<T> &q)
+    {
+        m00 = q.c;
+        m01 = -q.s;
+        m10 = q.s;
+        m11 = q.c;
+    }
+
+    Mat22 Abs(void) const
     {
-        return Mat2(std::abs(m00), std::abs(m01), std::abs(m10), std::abs(m11));
+        return Mat22(std::abs(m00), std::abs(m01), std::abs(m10), std::abs(m11));
     }
 
-    Vec AxisX(void) const
+    Vec2<T> AxisX(void) const
     {
-        return Vec(m00, m10);
+        return Vec2<T>(m00, m10);
     }
 
-    Vec AxisY(void) const
+    Vec2<T> AxisY(void) const
     {
-        return Vec(m01, m11);
+        return Vec2<T>(m01, m11);
     }
 
-    Mat2 Transpose(void) const
+    Mat22 Transpose(void) const
     {
-        return Mat2(m00, m10, m01, m11);
+        return Mat22(m00, m10, m01, m11);
     }
 
-    const Vec operator*(const Vec &rhs) const
+    const Vec2<T> operator*(const Vec2<T> &rhs) const
     {
-        return Vec(m00 * rhs.x + m01 * rhs.y, m10 * rhs.x + m11 * rhs.y);
+        return Vec2<T>(m00 * rhs.x + m01 * rhs.y, m10 * rhs.x + m11 * rhs.y);
     }
 
-    const Mat2 operator*(const Mat2 &rhs) const
+    const Mat22 operator*(const Mat22 &rhs) const
     {
         // [00 01]  [00 01]
         // [10 11]  [10 11]
 
-        return Mat2(
+        return Mat22(
             m[0][0] * rhs.m[0][0] + m[0][1] * rhs.m[1][0],
             m[0][0] * rhs.m[0][1] + m[0][1] * rhs.m[1][1],
             m[1][0] * rhs.m[0][0] + m[1][1] * rhs.m[1][0],
@@ -242,4 +331,38 @@ struct Mat2
     }
 };
 
+typedef Mat22<Real> Mat2;
+
+// Axis aligned bounding box
+struct AABB
+{
+    Vec min;
+    Vec max;
+
+    bool Overlaps(const AABB &rhs) const
+    {
+        return min.x <= rhs.max.x && rhs.min.x <= max.x &&
+               min.y <= rhs.max.y && rhs.min.y <= max.y;
+    }
+
+    bool Contains(const AABB &rhs) const
+    {
+        return min.x <= rhs.min.x && min.y <= rhs.min.y &&
+               rhs.max.x <= max.x && rhs.max.y <= max.y;
+    }
+
+    Real Perimeter(void) const
+    {
+        return 2.0 * ((max.x - min.x) + (max.y - min.y));
+    }
+};
+
+inline AABB Combine(const AABB &a, const AABB &b)
+{
+    AABB c;
+    c.min.Set(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y));
+    c.max.Set(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y));
+    return c;
+}
+
 #endif // PMATH_H
@@ -0,0 +1,62 @@
+#include "precompiled.h"
+
+Pool::Pool(int blockSize, int blocksPerChunk)
+    : allocations(0), frees(0), live(0), chunks(0), m_blocksPerChunk(blocksPerChunk), m_free(NULL)
+{
+    // Every block must hold a free list link and stay aligned for doubles
+    const int align = alignof(std::max_align_t);
+    blockSize = std::max(blockSize, (int)sizeof(Block));
+    m_blockSize = (blockSize + align - 1) / align * align;
+}
+
+Pool::~Pool()
+{
+    for (int i = 0; i < m_chunks.size(); ++i)
+        ::operator delete(m_chunks[i]);
+}
+
+void *Pool::Allocate(void)
+{
+    if (!m_free)
+    {
+        char *chunk = (char *)::operator new((size_t)m_blockSize * m_blocksPerChunk);
+        m_chunks.push_back(chunk);
+        ++chunks;
+        Chain(chunk);
+    }
+
+    Block *block = m_free;
+    m_free = block->next;
+    ++allocations;
+    ++live;
+    return block;
+}
+
+void Pool::Free(void *block)
+{
+    assert(block);
+    Block *b = (Block *)block;
+    b->next = m_free;
+    m_free = b;
+    ++frees;
+    --live;
+}
+
+void Pool::Clear(void)
+{
+    m_free = NULL;
+    for (int i = 0; i < m_chunks.size(); ++i)
+        Chain(m_chunks[i]);
+    live = 0;
+}
+
+// Push a chunk's blocks on the free list, the first block ends up on top
+void Pool::Chain(char *chunk)
+{
+    for (int i = m_blocksPerChunk - 1; i >= 0; --i)
+    {
+        Block *b = (Block *)(chunk + (size_t)i * m_blockSize);
+        b->next = m_free;
+        m_free = b;
+    }
+}
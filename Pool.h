@@ -0,0 +1,40 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "precompiled.h"
+
+// Fixed size blocks carved out of large chunks. Freed blocks go on a free
+// list and are handed out again before a new chunk is taken from the heap,
+// Clear returns every block at once and keeps the chunks for reuse.
+struct Pool
+{
+    Pool(int blockSize, int blocksPerChunk = 128);
+    ~Pool();
+
+    void *Allocate(void);
+    void Free(void *block);
+
+    // Objects in outstanding blocks must already be destroyed
+    void Clear(void);
+
+    // Counters for tests and tuning
+    long long allocations; // Blocks handed out since construction
+    long long frees;       // Blocks returned through Free, Clear not included
+    int live;              // Blocks currently handed out
+    int chunks;            // Chunks taken from the heap
+
+private:
+    struct Block
+    {
+        Block *next;
+    };
+
+    void Chain(char *chunk);
+
+    int m_blockSize;
+    int m_blocksPerChunk;
+    std::vector<char *> m_chunks;
+    Block *m_free;
+};
+
+#endif // POOL_H
@@ -1,110 +1,870 @@
 #include "precompiled.h"
 
-void IntegrateForces(Body *b, double dt)
+// Both run on the store's body i, which must be awake
+void IntegrateForces(BodyStore &store, int i, Real dt)
 {
-    if (b->im == 0.0f)
+    if (store.im[i] == 0.0f)
         return;
 
-    b->velocity += (b->force * b->im + gravity) * (dt / 2.0f);
-    b->angularVelocity += b->torque * b->iI * (dt / 2.0f);
+    store.velocity[i] += (store.force[i] * store.im[i] + gravity) * (dt / 2.0f);
+    store.angularVelocity[i] += store.torque[i] * store.iI[i] * (dt / 2.0f);
 }
 
-void IntegrateVelocity(Body *b, double dt)
+void IntegrateVelocity(BodyStore &store, int i, Real dt)
 {
-    if (b->im == 0.0f)
+    if (store.im[i] == 0.0f)
         return;
 
-    b->position += b->velocity * dt;
-    b->orient += b->angularVelocity * dt;
-    b->SetOrient(b->orient);
-    IntegrateForces(b, dt);
+    store.position[i] += store.velocity[i] * dt;
+    store.rotation[i] = store.rotation[i].Integrate(store.angularVelocity[i] * dt);
+    IntegrateForces(store, i, dt);
+}
+
+// Pair order, the broadphase hands out pairs with A->id < B->id
+static bool ContactLess(const Manifold &a, const Manifold &b)
+{
+    return a.A->id < b.A->id || (a.A->id == b.A->id && a.B->id < b.B->id);
 }
 
 void Scene::Step(void)
 {
+    // Where Render blends from until the next step
+    bodies.previousPosition = bodies.position;
+    bodies.previousRotation = bodies.rotation;
+
+    // Find candidate pairs
+    m_clock.Start();
+    broadphase->FindPairs(bodies.records, m_dynamicPairs);
+    FindStaticPairs();
+    pairs.clear();
+    std::merge(m_dynamicPairs.begin(), m_dynamicPairs.end(), m_staticPairs.begin(), m_staticPairs.end(),
+               std::back_inserter(pairs), PairLess);
+
+    // Pairs with nothing awake in them can't have changed since last step
+    auto asleep = [](const BodyPair &p) { return !p.A->awake && !p.B->awake; };
+    pairs.erase(std::remove_if(pairs.begin(), pairs.end(), asleep), pairs.end());
+    m_clock.Stop();
+
+    stats.bodyCount = bodies.Count();
+    stats.staticCount = statics.Count();
+    stats.allPairs = (long long)bodies.Count() * (bodies.Count() - 1) / 2;
+    stats.candidatePairs = pairs.size();
+    stats.broadphaseTime = m_clock.Difference();
+
     // Generate new collision info
-    contacts.clear();
-    for (int i = 0; i < bodies.size(); ++i)
+    m_clock.Start();
+    narrowphase.UpdateBodies(bodies, statics);
+    narrowphase.Collide(pairs, contacts);
+    m_clock.Stop();
+    stats.narrowphaseTime = m_clock.Difference();
+
+    // Anything touching a sleeping body wakes its island, which brings back
+    // the contacts the island went to sleep with
+    int collided = contacts.size();
+    for (int i = 0; i < contacts.size(); ++i)
     {
-        Body *A = bodies[i];
+        Body *A = contacts[i].A;
+        Body *B = contacts[i].B;
+        if (A->island >= 0)
+            WakeIsland(A->island);
+        if (B->island >= 0)
+            WakeIsland(B->island);
+    }
+    stats.contactCount = contacts.size();
+
+    // The narrowphase keeps pair order, woken contacts come in the order
+    // their islands fell asleep. Sorting them in makes constraint order, and
+    // with it coloring, depend on nothing but the body ids.
+    if (m_deterministic && contacts.size() > collided)
+        std::stable_sort(contacts.begin(), contacts.end(), ContactLess);
 
-        for (int j = i + 1; j < bodies.size(); ++j)
+    ++m_stepCount;
+    WarmStart();
+    BuildIslands();
+
+    // Islands share no dynamic bodies, so each one is solved on its own
+    m_clock.Start();
+    if (m_substeps > 1)
+        solver.SetSoftness(m_dt / m_substeps);
+    BuildSolveTasks();
+    auto solve = [this](int task) {
+        if (!m_wideTasks.empty())
         {
-            Body *B = bodies[j];
-            if (A->im == 0 && B->im == 0)
-                continue;
-            Manifold m(A, B);
-            m.Solve();
-            if (m.contact_count)
-                contacts.emplace_back(m);
+            SolveIsland(m_wideTasks[task], false);
+            return;
         }
+        for (int i = m_taskStart[task]; i < m_taskStart[task + 1]; ++i)
+            SolveIsland(islands[m_taskIslands[i]], false);
+    };
+    threadPool->Run(stats.solveTasks, solve);
+
+    // A pile too big for one thread is spread over the pool color by color
+    stats.coloredIslands = m_largeIslands.size();
+    stats.colorCount = 0;
+    stats.overflowContacts = 0;
+    memset(stats.colorSizes, 0, sizeof(stats.colorSizes));
+    for (int i = 0; i < m_largeIslands.size(); ++i)
+        SolveIsland(islands[m_largeIslands[i]], true);
+    m_clock.Stop();
+    stats.solveTime = m_clock.Difference();
+
+    stats.iterations = 0;
+    stats.residual = 0;
+    for (int i = 0; i < islands.size(); ++i)
+    {
+        stats.iterations = std::max(stats.iterations, islands[i].iterations);
+        stats.residual = std::max(stats.residual, islands[i].residual);
+    }
+    for (int i = 0; i < m_wideTasks.size(); ++i)
+    {
+        stats.iterations = std::max(stats.iterations, m_wideTasks[i].iterations);
+        stats.residual = std::max(stats.residual, m_wideTasks[i].residual);
     }
 
-    // Integrate forces
-    for (int i = 0; i < bodies.size(); ++i)
-        IntegrateForces(bodies[i], m_dt);
+    StoreImpulses();
 
-    // Initialize collision
-    for (int i = 0; i < contacts.size(); ++i)
-        contacts[i].Initialize();
+    UpdateSleep();
+}
+
+// Islands with at least this many contacts are colored instead of being
+// solved on one thread
+const int largeIslandContacts = 256;
+
+void Scene::BuildSolveTasks(void)
+{
+    m_taskIslands.clear();
+    m_largeIslands.clear();
+    for (int i = 0; i < islands.size(); ++i)
+    {
+        if (islands[i].contacts.size() >= largeIslandContacts)
+            m_largeIslands.push_back(i);
+        else
+            m_taskIslands.push_back(i);
+    }
+
+    // Heaviest islands first so the pool starts on them, smaller ones are
+    // batched until a task is worth scheduling
+    auto cost = [this](int i) { return islands[i].bodies.size() + islands[i].contacts.size(); };
+    std::stable_sort(m_taskIslands.begin(), m_taskIslands.end(),
+                     [&](int a, int b) { return cost(a) > cost(b); });
+
+    m_taskStart.clear();
+    int batch = 0;
+    for (int i = 0; i < m_taskIslands.size(); ++i)
+    {
+        if (batch == 0)
+            m_taskStart.push_back(i);
+        batch += cost(m_taskIslands[i]);
+        if (batch >= m_batchSize)
+            batch = 0;
+    }
+    stats.solveTasks = m_taskStart.size();
+    m_taskStart.push_back(m_taskIslands.size());
+
+    m_wideTasks.clear();
+    if (solver.wide && !m_deterministic && m_substeps == 1)
+        PackWideTasks();
+}
+
+// Most islands are a handful of contacts, too few to fill a SolveWide group
+// on their own. Islands share no dynamic bodies, so each task's islands are
+// merged and solved as one, iterating until the slowest has converged, and
+// their contacts are packed into groups across island boundaries.
+// Constraints are renumbered task by task, large islands take the runs
+// after them and are colored as before.
+void Scene::PackWideTasks(void)
+{
+    m_colorMasks.resize(bodies.Count());
+    m_wideTasks.resize(stats.solveTasks);
+    int constraint = 0;
+    for (int t = 0; t < stats.solveTasks; ++t)
+    {
+        Island &task = m_wideTasks[t];
+        task.bodies.clear();
+        task.contacts.clear();
+        for (int i = m_taskStart[t]; i < m_taskStart[t + 1]; ++i)
+        {
+            const Island &island = islands[m_taskIslands[i]];
+            task.bodies.insert(task.bodies.end(), island.bodies.begin(), island.bodies.end());
+            task.contacts.insert(task.contacts.end(), island.contacts.begin(), island.contacts.end());
+        }
+
+        m_packing.Build(task, contacts, m_colorMasks, wideGroupSize);
+        task.firstConstraint = constraint;
+        for (int i = 0; i < m_packing.grouped.size(); ++i)
+            NumberConstraint(m_packing.grouped[i], constraint++);
+        task.groupedEnd = constraint;
+        for (int i = 0; i < m_packing.rest.size(); ++i)
+            NumberConstraint(m_packing.rest[i], constraint++);
+    }
+
+    for (int i = 0; i < m_largeIslands.size(); ++i)
+    {
+        Island &island = islands[m_largeIslands[i]];
+        island.firstConstraint = constraint;
+        island.groupedEnd = constraint;
+        constraint += island.contacts.size();
+    }
+}
+
+// Splits [0, count) into m_batchSize runs and calls callback(begin, end, task)
+// for each across the pool
+template <typename Callback>
+void Scene::ParallelFor(int count, Callback callback)
+{
+    int tasks = (count + m_batchSize - 1) / m_batchSize;
+    m_batchResidual.assign(tasks, 0.0);
+    auto run = [&](int task) {
+        int begin = task * m_batchSize;
+        callback(begin, std::min(begin + m_batchSize, count), task);
+    };
+    threadPool->Run(tasks, run);
+}
+
+template <typename Callback>
+void Scene::ForBodies(const Island &island, bool colored, Callback callback)
+{
+    const std::vector<int> &list = island.bodies;
+    if (!colored)
+    {
+        for (int i = 0; i < list.size(); ++i)
+            callback(list[i]);
+        return;
+    }
+
+    ParallelFor(list.size(), [&](int begin, int end, int task) {
+        for (int i = begin; i < end; ++i)
+            callback(list[i]);
+    });
+}
+
+template <typename Callback>
+void Scene::ForContacts(const Island &island, bool colored, Callback callback)
+{
+    const std::vector<int> &list = island.contacts;
+    if (!colored)
+    {
+        for (int i = 0; i < list.size(); ++i)
+            callback(contacts[list[i]]);
+        return;
+    }
+
+    ParallelFor(list.size(), [&](int begin, int end, int task) {
+        for (int i = begin; i < end; ++i)
+            callback(contacts[list[i]]);
+    });
+}
+
+template <typename Callback>
+Real Scene::ForConstraints(const Island &island, bool colored, Callback callback)
+{
+    int first = island.firstConstraint;
+    int last = first + island.contacts.size();
+    if (!colored)
+    {
+        // Groups packed by PackWideTasks first, then the rest
+        if (island.groupedEnd == first)
+            return callback(first, last, false);
+        Real result = callback(first, island.groupedEnd, true);
+        return std::max(result, callback(island.groupedEnd, last, false));
+    }
+
+    // One color at a time, each color spread over the pool, then the
+    // contacts that didn't get a color on this thread
+    const ConstraintColoring &coloring = m_coloring;
+    Real result = 0;
+    for (int c = 0; c < coloring.colorCount; ++c)
+    {
+        int start = m_colorStart[c];
+        ParallelFor(m_colorStart[c + 1] - start, [&](int begin, int end, int task) {
+            m_batchResidual[task] = callback(start + begin, start + end, true);
+        });
+        for (int i = 0; i < m_batchResidual.size(); ++i)
+            result = std::max(result, m_batchResidual[i]);
+    }
+    return std::max(result, callback(m_colorStart[coloring.colorCount], last, false));
+}
+
+void Scene::ColorIsland(Island &island)
+{
+    m_colorMasks.resize(bodies.Count());
+    m_coloring.Build(island, contacts, m_colorMasks);
 
-    // Solve collisions
-    for (int j = 0; j < m_iterations; ++j)
-        for (int i = 0; i < contacts.size(); ++i)
-            contacts[i].ApplyImpulse();
+    const ConstraintColoring &coloring = m_coloring;
+    stats.colorCount = std::max(stats.colorCount, coloring.colorCount);
+    for (int c = 0; c < coloring.colorCount; ++c)
+        stats.colorSizes[c] += coloring.colors[c].size();
+    stats.overflowContacts += coloring.overflow.size();
 
-    // Integrate velocities
-    for (int i = 0; i < bodies.size(); ++i)
-        IntegrateVelocity(bodies[i], m_dt);
+    // Renumber the island's constraints color by color, overflow last
+    int constraint = island.firstConstraint;
+    for (int c = 0; c < coloring.colorCount; ++c)
+    {
+        m_colorStart[c] = constraint;
+        for (int i = 0; i < coloring.colors[c].size(); ++i)
+            NumberConstraint(coloring.colors[c][i], constraint++);
+    }
+    m_colorStart[coloring.colorCount] = constraint;
+    for (int i = 0; i < coloring.overflow.size(); ++i)
+        NumberConstraint(coloring.overflow[i], constraint++);
+}
+
+void Scene::NumberConstraint(int contact, int constraint)
+{
+    contacts[contact].constraint = constraint;
+    solver.contact[constraint] = contact;
+}
+
+void Scene::SolveIsland(Island &island, bool colored)
+{
+    if (colored)
+        ColorIsland(island);
+
+    bool soft = m_substeps > 1;
+
+    // Integrate forces, soft steps integrate them per substep instead
+    ForBodies(island, colored, [&](int i) {
+        if (!soft)
+            IntegrateForces(bodies, i, m_dt);
+        solver.LoadBody(bodies, i);
+    });
+
+    // Initialize collision, every restitution target is taken from the
+    // bodies, before any warm start impulse is applied to the solver
+    ForContacts(island, colored, [&](Manifold &m) { m.Initialize(&solver, m_dt); });
+
+    island.iterations = 0;
+    island.residual = 0;
+
+    if (soft)
+    {
+        SoftStep(island, colored);
+    }
+    else
+    {
+        ForConstraints(island, colored, [&](int begin, int end, bool grouped) {
+            solver.WarmStart(begin, end);
+            return Real(0);
+        });
+
+        // Solve collisions until a pass barely changes any velocity
+        while (island.iterations < m_iterations)
+        {
+            Real residual = ForConstraints(island, colored, [&](int begin, int end, bool grouped) {
+                if (grouped && solver.wide && !m_deterministic)
+                    return solver.SolveWide(begin, end);
+                return solver.Solve(begin, end);
+            });
+            ++island.iterations;
+            island.residual = residual;
+            if (residual < m_tolerance)
+                break;
+        }
+    }
+
+    ForContacts(island, colored, [&](Manifold &m) { m.ReadImpulses(&solver); });
+
+    // Integrate velocities, and while each body is at hand clear the forces
+    // it has used up and count its time towards sleep. Soft steps have no
+    // positional correction to wait for, so their geometry is updated in the
+    // same pass.
+    const Real linTolSqr = linearSleepTolerance * linearSleepTolerance;
+    const Real angTolSqr = angularSleepTolerance * angularSleepTolerance;
+    ForBodies(island, colored, [&](int i) {
+        solver.StoreBody(bodies, i);
+        if (soft)
+            solver.StorePosition(bodies, i);
+        else
+            IntegrateVelocity(bodies, i, m_dt);
+        bodies.force[i].Set(0, 0);
+        bodies.torque[i] = 0;
+
+        Body *b = bodies.records[i];
+        if (m_allowSleep)
+        {
+            if (bodies.velocity[i].squared_vec_length() > linTolSqr ||
+                Sqr(bodies.angularVelocity[i]) > angTolSqr)
+                b->sleepTime = 0;
+            else
+                b->sleepTime += m_dt;
+        }
+
+        if (soft)
+            b->shape->UpdateGeometry();
+    });
+
+    if (soft)
+        return;
 
     // Correct positions
+    ForConstraints(island, colored, [&](int begin, int end, bool grouped) {
+        for (int c = begin; c < end; ++c)
+            contacts[solver.contact[c]].PositionalCorrection();
+        return Real(0);
+    });
+
+    // The next step's collision and Publish use the bodies where they
+    // ended up
+    ForBodies(island, colored, [&](int i) { bodies.records[i]->shape->UpdateGeometry(); });
+}
+
+void Scene::SoftStep(Island &island, bool colored)
+{
+    // Contact geometry stays as the narrowphase found it, substeps track
+    // how far the bodies moved since and solve against that
+    Real h = m_dt / m_substeps;
+    for (int i = 0; i < m_substeps; ++i)
+    {
+        ForBodies(island, colored, [&](int i) { solver.IntegrateVelocity(i, h); });
+        ForConstraints(island, colored, [&](int begin, int end, bool grouped) {
+            solver.WarmStart(begin, end);
+            return solver.SolveSoft(begin, end, true);
+        });
+        ForBodies(island, colored, [&](int i) { solver.IntegratePosition(i, h); });
+
+        // Relax, take out the velocity the soft bias added
+        island.residual = ForConstraints(island, colored, [&](int begin, int end, bool grouped) {
+            return solver.SolveSoft(begin, end, false);
+        });
+        ++island.iterations;
+    }
+
+    ForConstraints(island, colored, [&](int begin, int end, bool grouped) {
+        solver.ApplyRestitution(begin, end);
+        return Real(0);
+    });
+}
+
+void Scene::SetThreadCount(int count)
+{
+    delete threadPool;
+    threadPool = new ThreadPool(count);
+}
+
+void Scene::WarmStart(void)
+{
+    for (int i = 0; i < contacts.size(); ++i)
+    {
+        Manifold &m = contacts[i];
+        BodyPair p = {m.A, m.B};
+        auto it = contactCache.find(PairKey(p));
+        if (it == contactCache.end())
+            continue;
+
+        const CachedContact &c = it->second;
+        for (int j = 0; j < m.contact_count; ++j)
+            for (int k = 0; k < c.contact_count; ++k)
+                if (m.features[j] == c.features[k])
+                {
+                    m.normalImpulse[j] = c.normalImpulse[k];
+                    m.tangentImpulse[j] = c.tangentImpulse[k];
+                }
+    }
+}
+
+void Scene::StoreImpulses(void)
+{
+    for (int i = 0; i < contacts.size(); ++i)
+    {
+        const Manifold &m = contacts[i];
+        BodyPair p = {m.A, m.B};
+        CachedContact &c = contactCache[PairKey(p)];
+        c.contact_count = m.contact_count;
+        c.step = m_stepCount;
+        for (int j = 0; j < m.contact_count; ++j)
+        {
+            c.features[j] = m.features[j];
+            c.normalImpulse[j] = m.normalImpulse[j];
+            c.tangentImpulse[j] = m.tangentImpulse[j];
+        }
+    }
+
+    // Pairs that stopped touching start from zero if they touch again
+    for (auto it = contactCache.begin(); it != contactCache.end();)
+    {
+        if (it->second.step != m_stepCount)
+            it = contactCache.erase(it);
+        else
+            ++it;
+    }
+}
+
+void Scene::BuildIslands(void)
+{
+    int count = bodies.Count();
+    m_unionFind.Reset(count);
     for (int i = 0; i < contacts.size(); ++i)
-        contacts[i].PositionalCorrection();
+    {
+        const Manifold &m = contacts[i];
+        if (m.A->im != 0 && m.B->im != 0)
+            m_unionFind.Union(m.A->index, m.B->index);
+    }
 
-    // Clear all forces
-    for (int i = 0; i < bodies.size(); ++i)
+    islands.clear();
+    m_islandOf.assign(count, -1);
+    stats.awakeCount = 0;
+    for (int i = 0; i < count; ++i)
     {
-        Body *b = bodies[i];
-        b->force.Set(0, 0);
-        b->torque = 0;
+        if (!bodies.records[i]->awake)
+            continue;
+
+        int root = m_unionFind.Find(i);
+        if (m_islandOf[root] < 0)
+        {
+            m_islandOf[root] = islands.size();
+            islands.push_back(Island());
+        }
+        islands[m_islandOf[root]].bodies.push_back(i);
+        ++stats.awakeCount;
+    }
+
+    // Every contact has at least one awake dynamic body
+    for (int i = 0; i < contacts.size(); ++i)
+    {
+        const Manifold &m = contacts[i];
+        Body *b = m.A->im != 0 ? m.A : m.B;
+        islands[m_islandOf[m_unionFind.Find(b->index)]].contacts.push_back(i);
+    }
+    stats.islandCount = islands.size();
+
+    // Number constraints island by island so each solves a contiguous run
+    solver.Resize(count, contacts.size());
+    int constraint = 0;
+    for (int i = 0; i < islands.size(); ++i)
+    {
+        Island &island = islands[i];
+        island.firstConstraint = constraint;
+        island.groupedEnd = constraint;
+        for (int j = 0; j < island.contacts.size(); ++j)
+            NumberConstraint(island.contacts[j], constraint++);
     }
 }
 
-void Scene::Render(void)
+void Scene::UpdateSleep(void)
 {
-    for (int i = 0; i < bodies.size(); ++i)
+    if (!m_allowSleep)
+        return;
+
+    for (int i = 0; i < islands.size(); ++i)
     {
-        Body *b = bodies[i];
-        b->shape->Draw();
+        Island &island = islands[i];
+
+        // An island sleeps once its most restless body has been still long
+        // enough, SolveIsland kept every body's sleep time
+        Real minSleepTime = FLT_MAX;
+        for (int j = 0; j < island.bodies.size(); ++j)
+            minSleepTime = std::min(minSleepTime, bodies.records[island.bodies[j]]->sleepTime);
+
+        if (minSleepTime < timeToSleep)
+            continue;
+
+        int slot;
+        if (m_freeIslands.empty())
+        {
+            slot = sleepingIslands.size();
+            sleepingIslands.push_back(SleepingIsland());
+        }
+        else
+        {
+            slot = m_freeIslands.back();
+            m_freeIslands.pop_back();
+        }
+
+        SleepingIsland &sleeping = sleepingIslands[slot];
+        sleeping.bodies.clear();
+        for (int j = 0; j < island.contacts.size(); ++j)
+        {
+            Manifold m = contacts[island.contacts[j]];
+            m.sat = NULL; // The narrowphase drops caches of pairs it stops seeing
+            sleeping.contacts.push_back(m);
+        }
+
+        for (int j = 0; j < island.bodies.size(); ++j)
+        {
+            int k = island.bodies[j];
+            Body *b = bodies.records[k];
+            b->awake = false;
+            b->island = slot;
+            bodies.velocity[k].Set(0, 0);
+            bodies.angularVelocity[k] = 0;
+            sleeping.bodies.push_back(b);
+        }
+    }
+}
+
+void Scene::WakeIsland(int slot)
+{
+    SleepingIsland &sleeping = sleepingIslands[slot];
+    for (int i = 0; i < sleeping.bodies.size(); ++i)
+    {
+        Body *b = sleeping.bodies[i];
+        b->awake = true;
+        b->sleepTime = 0;
+        b->island = -1;
+    }
+    contacts.insert(contacts.end(), sleeping.contacts.begin(), sleeping.contacts.end());
+
+    sleeping.bodies.clear();
+    sleeping.contacts.clear();
+    m_freeIslands.push_back(slot);
+}
+
+void Scene::Wake(BodyHandle h)
+{
+    Body *b = bodies.Get(h);
+    if (b && b->island >= 0)
+        WakeIsland(b->island);
+}
+
+void Scene::SetAllowSleep(bool allow)
+{
+    m_allowSleep = allow;
+    if (allow)
+        return;
+
+    for (int i = 0; i < sleepingIslands.size(); ++i)
+        if (!sleepingIslands[i].bodies.empty())
+            WakeIsland(i);
+
+    for (int i = 0; i < bodies.Count(); ++i)
+        bodies.records[i]->sleepTime = 0;
+}
+
+void Scene::FindStaticPairs(void)
+{
+    m_staticPairs.clear();
+    for (int i = 0; i < bodies.Count(); ++i)
+    {
+        Body *A = bodies.records[i];
+        if (A->im == 0 || !A->awake)
+            continue;
+
+        auto callback = [&](int proxyId) {
+            Body *B = (Body *)staticTree.GetUserData(proxyId);
+            m_staticPairs.push_back(MakePair(A, B));
+            return true;
+        };
+        staticTree.Query(A->Bounds(), callback);
     }
+    std::sort(m_staticPairs.begin(), m_staticPairs.end(), PairLess);
+}
 
+void Scene::Publish(Real remainder)
+{
+    Snapshot &snapshot = m_snapshots.Back();
+    snapshot.Clear();
+    snapshot.AddBodies(statics);
+    snapshot.AddBodies(bodies);
     for (int i = 0; i < contacts.size(); ++i)
     {
-        Manifold &m = contacts[i];
-        Vec n = m.normal;
+        const Manifold &m = contacts[i];
         for (int j = 0; j < m.contact_count; ++j)
         {
-            Vec c = m.contacts[j];
-            int x1 = c.x, y1 = c.y;
-            n *= 0.75f;
-            c += n;
-            int x2 = c.x, y2 = c.y;
-            S2D_DrawLine(x1, y1, x2, y2,
-                         40,
-                         1.0, 1.0, 1.0, 1.0,
-                         1.0, 1.0, 1.0, 1.0,
-                         1.0, 1.0, 1.0, 1.0,
-                         1.0, 1.0, 1.0, 1.0);
+            SnapshotContact c = {m.contacts[j], m.normal};
+            snapshot.contacts.push_back(c);
+        }
+    }
+    snapshot.step = m_stepCount;
+    snapshot.dt = m_dt;
+    snapshot.remainder = remainder;
+    snapshot.time = std::chrono::steady_clock::now();
+    m_snapshots.Publish();
+}
+
+void Scene::Render(void)
+{
+    const Snapshot &snapshot = m_snapshots.Front();
+
+    // The stepping thread may be asleep until the next step, count the time
+    // since it published too. A paused scene settles on the last step.
+    std::chrono::duration<Real> late = std::chrono::steady_clock::now() - snapshot.time;
+    Real alpha = snapshot.dt > 0 ? Clamp(Real(0), Real(1), (snapshot.remainder + late.count()) / snapshot.dt) : 1;
+
+    Vec v[MaxPolyVertexCount];
+    std::vector<Vec> hull;
+    for (int i = 0; i < snapshot.bodies.size(); ++i)
+    {
+        const SnapshotBody &b = snapshot.bodies[i];
+        Vec position = b.previousPosition + (b.position - b.previousPosition) * alpha;
+        if (b.vertexCount == 0)
+        {
+            S2D_DrawCircle(position.x, position.y, b.radius, 100, b.r, b.g, b.b, 1);
+            continue;
+        }
+
+        Vec *world = v;
+        if (b.vertexCount > MaxPolyVertexCount)
+        {
+            hull.resize(b.vertexCount);
+            world = &hull[0];
+        }
+        Mat2 u;
+        u.Set(b.previousRotation.Blend(b.rotation, alpha));
+        for (int j = 0; j < b.vertexCount; ++j)
+            world[j] = position + u * snapshot.vertices[b.firstVertex + j];
 
+        if (b.vertexCount == 3)
+        {
+            S2D_DrawTriangle(
+                world[0].x, world[0].y, b.r, b.g, b.b, 1,
+                world[1].x, world[1].y, b.r, b.g, b.b, 1,
+                world[2].x, world[2].y, b.r, b.g, b.b, 1);
+        }
+        else if (b.vertexCount == 4)
+        {
+            S2D_DrawQuad(
+                world[0].x, world[0].y, b.r, b.g, b.b, 1,
+                world[1].x, world[1].y, b.r, b.g, b.b, 1,
+                world[2].x, world[2].y, b.r, b.g, b.b, 1,
+                world[3].x, world[3].y, b.r, b.g, b.b, 1);
+        }
+        else
+        {
+            // Triangle fan around the centroid (the model space origin)
+            for (int i1 = 0; i1 < b.vertexCount; ++i1)
+            {
+                int i2 = i1 + 1 < b.vertexCount ? i1 + 1 : 0;
+                S2D_DrawTriangle(
+                    position.x, position.y, b.r, b.g, b.b, 1,
+                    world[i1].x, world[i1].y, b.r, b.g, b.b, 1,
+                    world[i2].x, world[i2].y, b.r, b.g, b.b, 1);
+            }
         }
     }
+
+    for (int i = 0; i < snapshot.contacts.size(); ++i)
+    {
+        Vec c = snapshot.contacts[i].point;
+        Vec n = snapshot.contacts[i].normal * 0.75f;
+        int x1 = c.x, y1 = c.y;
+        c += n;
+        int x2 = c.x, y2 = c.y;
+        S2D_DrawLine(x1, y1, x2, y2,
+                     40,
+                     1.0, 1.0, 1.0, 1.0,
+                     1.0, 1.0, 1.0, 1.0,
+                     1.0, 1.0, 1.0, 1.0,
+                     1.0, 1.0, 1.0, 1.0);
+    }
 }
 
-Body *Scene::Add(Shape *shape, int x, int y)
+void Scene::Post(const Command &command)
+{
+    std::lock_guard<std::mutex> lock(m_commandMutex);
+    m_commands.push_back(command);
+}
+
+void Scene::RunCommands(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        m_running.swap(m_commands);
+    }
+
+    // Commands may post more, those wait for the next call
+    for (int i = 0; i < m_running.size(); ++i)
+        m_running[i](*this);
+    m_running.clear();
+}
+
+BodyHandle Scene::Add(Shape *shape, int x, int y)
+{
+    assert(shape);
+    Body *b = bodies.Add(shape, x, y);
+    b->id = m_nextId++;
+    broadphase->Insert(b);
+    return bodies.GetHandle(b);
+}
+
+BodyHandle Scene::AddStatic(Shape *shape, int x, int y, Real radians)
 {
     assert(shape);
-    Body *b = new Body(shape, x, y);
-    bodies.push_back(b);
-    return b;
+    Body *b = statics.Add(shape, x, y);
+    b->id = m_nextId++;
+    b->SetStatic();
+    b->SetOrient(radians);
+
+    b->proxyId = staticTree.CreateProxy(b->Bounds(), b);
+    return statics.GetHandle(b);
+}
+
+bool Scene::Remove(BodyHandle h)
+{
+    Body *b = bodies.Get(h);
+    if (!b)
+        return false;
+
+    // A body made static with SetStatic belongs to no island but can still
+    // hold sleepers up
+    if (b->island >= 0)
+        WakeIsland(b->island);
+    else if (b->im == 0)
+        WakeResting(b);
+    DropContacts(b);
+    broadphase->Remove(b);
+    bodies.Remove(b);
+    return true;
+}
+
+bool Scene::RemoveStatic(BodyHandle h)
+{
+    Body *b = statics.Get(h);
+    if (!b)
+        return false;
+
+    WakeResting(b);
+    DropContacts(b);
+    staticTree.DestroyProxy(b->proxyId);
+    statics.Remove(b);
+    return true;
+}
+
+// Statics aren't part of any island, find the sleepers resting on b
+void Scene::WakeResting(Body *b)
+{
+    for (int i = 0; i < sleepingIslands.size(); ++i)
+    {
+        const std::vector<Manifold> &list = sleepingIslands[i].contacts;
+        for (int j = 0; j < list.size(); ++j)
+            if (list[j].A == b || list[j].B == b)
+            {
+                WakeIsland(i);
+                break;
+            }
+    }
+}
+
+// Last step's contacts are kept for Render, none may point at a removed body
+void Scene::DropContacts(Body *b)
+{
+    auto touches = [b](const Manifold &m) { return m.A == b || m.B == b; };
+    contacts.erase(std::remove_if(contacts.begin(), contacts.end(), touches), contacts.end());
+}
+
+void Scene::Clear(void)
+{
+    broadphase->Clear();
+    staticTree = DynamicTree();
+    bodies.Clear();
+    statics.Clear();
+
+    contacts.clear();
+    pairs.clear();
+    m_staticPairs.clear();
+    m_dynamicPairs.clear();
+    contactCache.clear();
+    narrowphase.satCache.clear();
+    islands.clear();
+    sleepingIslands.clear();
+    m_freeIslands.clear();
+}
+
+void Scene::SetBroadphase(Broadphase *bp)
+{
+    assert(bp);
+    delete broadphase;
+    broadphase = bp;
+    for (int i = 0; i < bodies.Count(); ++i)
+        broadphase->Insert(bodies.records[i]);
 }
 
@@ -1,26 +1,206 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <simple2d.h>
 #include "precompiled.h"
 
+// Counters filled in by Scene::Step
+struct StepStats
+{
+    int bodyCount;            // Dynamic bodies
+    int staticCount;
+    long long allPairs;       // Pairs the brute force loop would test
+    int candidatePairs;       // Pairs reported by the broadphase
+    int contactCount;         // Pairs that produced a contact
+    long long broadphaseTime; // Nanoseconds spent in the broadphase
+    long long narrowphaseTime;
+    int iterations;           // Solver passes actually run
+    Real residual;            // Largest velocity change in the last pass
+    int awakeCount;           // Dynamic bodies simulated this step
+    int islandCount;          // Awake islands
+    int solveTasks;           // Island batches handed to the thread pool
+    int coloredIslands;       // Islands large enough to be solved by color
+    int colorCount;           // Most colors any of them needed
+    int colorSizes[maxColors]; // Contacts per color, summed over those islands
+    int overflowContacts;     // Contacts left without a color
+    long long solveTime;
+};
+
+// Impulses a touching pair finished a step with, matched by contact feature
+// on the next step to warm start the solver
+struct CachedContact
+{
+    int contact_count;
+    unsigned features[2];
+    Real normalImpulse[2];
+    Real tangentImpulse[2];
+    unsigned step; // Last step the pair touched
+};
+
 struct Scene
 {
 
-    double m_dt;
-    int m_iterations;
-    std::vector<Body *> bodies;
+    Real m_dt;
+    int m_iterations; // Upper bound on solver passes per step
+    Real m_tolerance; // Stop solving once a pass changes no velocity by more than this
+    BodyStore bodies;            // Dynamic bodies
+    BodyStore statics;           // Bodies added with AddStatic, never moved
+    DynamicTree staticTree;      // Built up once as statics are added
     std::vector<Manifold> contacts;
+    std::vector<BodyPair> pairs;
+    Broadphase *broadphase;
+    StepStats stats;
+    Narrowphase narrowphase;
+    std::unordered_map<unsigned long long, CachedContact> contactCache;
+    std::vector<Island> islands;                 // Awake islands this step
+    std::vector<SleepingIsland> sleepingIslands; // Indexed by Body::island
+    ThreadPool *threadPool;
+    ContactSolver solver;
 
-    Scene(double dt, int iterations)
-        : m_dt(dt), m_iterations(iterations)
+    Scene(Real dt, int iterations)
+        : m_dt(dt), m_iterations(iterations), m_tolerance(0.01), broadphase(new HashGridBroadphase(128.0)), threadPool(new ThreadPool(1)), m_nextId(0), m_stepCount(0), m_allowSleep(true), m_substeps(1), m_batchSize(64), m_deterministic(false)
     {
         std::cout<<"FGG"<<"\n";
+        memset(&stats, 0, sizeof(stats));
     }
 
+    // The pool joins its workers as it goes
+    ~Scene()
+    {
+        delete threadPool;
+        delete broadphase;
+    }
+
+    // Owns the broadphase and the pool
+    Scene(const Scene &) = delete;
+    Scene &operator=(const Scene &) = delete;
+
     void Step(void);
+
+    // Copies what Render draws into the snapshot buffer, call from the
+    // thread that steps once its steps for the frame are done. remainder is
+    // the time left in the caller's accumulator, less than one step.
+    void Publish(Real remainder = 0);
+
+    // Draws the last published snapshot, safe from another thread than the
+    // one stepping. Bodies are blended between their transforms before and
+    // after the last step by how far the clock has run into the next one,
+    // so the step rate can be lower than the frame rate without judder.
+    // The picture lags the simulation by up to one step.
     void Render(void);
-    Body *Add(Shape *shape, int x, int y);
+
+    // Queues command to run on the stepping thread at its next RunCommands.
+    // The only other call besides Render that is safe from any thread.
+    typedef std::function<void(Scene &)> Command;
+    void Post(const Command &command);
+    void RunCommands(void);
+
+    BodyHandle Add(Shape *shape, int x, int y);
+
+    // Static bodies are placed once and kept out of the broadphase and the
+    // integration loops, dynamic bodies query them through staticTree
+    BodyHandle AddStatic(Shape *shape, int x, int y, Real radians);
+
+    // NULL once the handle's body is gone. Bodies can move in memory between
+    // steps, the pointer is only good until the next call into the scene.
+    Body *GetBody(BodyHandle h) { return bodies.Get(h); }
+    Body *GetStatic(BodyHandle h) { return statics.Get(h); }
+
+    // Removal costs O(contacts + pairs). The store frees the slot in O(1),
+    // but the last step's contacts are scanned for the body, zero mass
+    // bodies also scan the sleeping islands' contacts, and the tree and
+    // sweep and prune broadphases rewrite their pair lists. A sleeping
+    // island losing a body wakes up. Both return false for stale handles.
+    bool Remove(BodyHandle h);
+    bool RemoveStatic(BodyHandle h);
+
+    // Drops every body and contact, the pools keep their memory for reuse
     void Clear(void);
+
+    // Takes ownership of bp and hands it every body already in the scene
+    void SetBroadphase(Broadphase *bp);
+    void SetTolerance(Real tolerance) { m_tolerance = tolerance; }
+
+    // Islands are solved in parallel on count threads, including the caller
+    void SetThreadCount(int count);
+
+    // Work handed to the pool at once: bodies plus contacts of batched small
+    // islands, or bodies, contacts or constraints of one colored island
+    void SetBatchSize(int size) { m_batchSize = std::max(size, 1); }
+
+    // Above one, each step is split into count substeps of one soft solve
+    // and one relax pass each, reusing the step's contacts
+    void SetSubsteps(int count) { m_substeps = std::max(count, 1); }
+
+    // Steps come out bit-identical for any thread count and batch size, on
+    // CPUs with or without AVX2.
+    // Islands and colors are already solved in an order that doesn't depend
+    // on the pool, and the only reduction, the residual, is a max. This mode
+    // also sorts woken contacts back into pair order and keeps to the scalar
+    // solver, since SolveWide rounds differently from Solve and is only used
+    // where the CPU has AVX2.
+    void SetDeterministic(bool enable) { m_deterministic = enable; }
+
+    // Turning sleep off wakes every sleeping body
+    void SetAllowSleep(bool allow);
+
+    // Wakes b along with the rest of its sleeping island
+    void Wake(BodyHandle h);
+
+private:
+    void FindStaticPairs(void);
+    void WarmStart(void);
+    void StoreImpulses(void);
+    void BuildIslands(void);
+    void BuildSolveTasks(void);
+    void PackWideTasks(void);
+    void ColorIsland(Island &island);
+    void NumberConstraint(int contact, int constraint);
+    void SolveIsland(Island &island, bool colored);
+    void SoftStep(Island &island, bool colored);
+
+    template <typename Callback>
+    void ParallelFor(int count, Callback callback);
+
+    // Island phases, spread over the pool when the island is colored.
+    // ForConstraints calls callback(begin, end, grouped) on runs of
+    // constraints, grouped runs may go through SolveWide.
+    template <typename Callback>
+    void ForBodies(const Island &island, bool colored, Callback callback);
+    template <typename Callback>
+    void ForContacts(const Island &island, bool colored, Callback callback);
+    template <typename Callback>
+    Real ForConstraints(const Island &island, bool colored, Callback callback);
+    void UpdateSleep(void);
+    void WakeIsland(int slot);
+    void WakeResting(Body *b);
+    void DropContacts(Body *b);
+
+    unsigned m_nextId;
+    unsigned m_stepCount;
+    std::vector<BodyPair> m_staticPairs;
+    std::vector<BodyPair> m_dynamicPairs;
+    UnionFind m_unionFind;
+    std::vector<int> m_islandOf;   // Island per union-find root
+    std::vector<int> m_freeIslands; // Unused sleepingIslands slots
+    std::vector<int> m_taskIslands; // Islands grouped by solve task
+    std::vector<int> m_taskStart;   // Task i solves m_taskIslands[m_taskStart[i], m_taskStart[i + 1])
+    std::vector<int> m_largeIslands;
+    std::vector<Island> m_wideTasks; // Each task's islands solved as one, when packing for SolveWide
+    WidePacking m_packing;
+    ConstraintColoring m_coloring;
+    std::vector<unsigned> m_colorMasks;  // Colors used per Body::index
+    std::vector<Real> m_batchResidual;   // Per ParallelFor task
+    int m_colorStart[maxColors + 1];     // First constraint of each color
+    bool m_allowSleep;
+    int m_substeps;
+    int m_batchSize;
+    bool m_deterministic;
+    Clock m_clock;
+    SnapshotBuffer m_snapshots;
+    std::mutex m_commandMutex;
+    std::vector<Command> m_commands; // Posted since the last RunCommands
+    std::vector<Command> m_running;
 };
 
-#endif // SCENE_H
\ No newline at end of file
+#endif // SCENE_H
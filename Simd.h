@@ -0,0 +1,152 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "precompiled.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+#ifdef SIMD_X86
+
+// Thin layer over AVX2 so the batch kernels are written once for both
+// precisions. A VReal holds simdWidth reals, four doubles or eight floats.
+// Callers must be compiled for AVX2 themselves.
+#define SIMD_INLINE static inline __attribute__((target("avx2"), always_inline))
+
+#ifdef PHYSICS_FLOAT
+
+typedef __m256 VReal;
+const int simdWidth = 8;
+
+SIMD_INLINE VReal VSet(Real a) { return _mm256_set1_ps(a); }
+SIMD_INLINE VReal VZero(void) { return _mm256_setzero_ps(); }
+SIMD_INLINE VReal VTrue(void) { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+SIMD_INLINE VReal VLoad(const Real *p) { return _mm256_loadu_ps(p); }
+SIMD_INLINE void VStore(Real *p, VReal a) { _mm256_storeu_ps(p, a); }
+SIMD_INLINE VReal VAdd(VReal a, VReal b) { return _mm256_add_ps(a, b); }
+SIMD_INLINE VReal VSub(VReal a, VReal b) { return _mm256_sub_ps(a, b); }
+SIMD_INLINE VReal VMul(VReal a, VReal b) { return _mm256_mul_ps(a, b); }
+SIMD_INLINE VReal VDiv(VReal a, VReal b) { return _mm256_div_ps(a, b); }
+SIMD_INLINE VReal VMax(VReal a, VReal b) { return _mm256_max_ps(a, b); }
+SIMD_INLINE VReal VSqrt(VReal a) { return _mm256_sqrt_ps(a); }
+SIMD_INLINE VReal VAnd(VReal a, VReal b) { return _mm256_and_ps(a, b); }
+SIMD_INLINE VReal VAndNot(VReal a, VReal b) { return _mm256_andnot_ps(a, b); }
+SIMD_INLINE VReal VOr(VReal a, VReal b) { return _mm256_or_ps(a, b); }
+SIMD_INLINE VReal VXor(VReal a, VReal b) { return _mm256_xor_ps(a, b); }
+SIMD_INLINE VReal VLess(VReal a, VReal b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+SIMD_INLINE VReal VGreater(VReal a, VReal b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+SIMD_INLINE VReal VEqual(VReal a, VReal b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+SIMD_INLINE VReal VBlend(VReal a, VReal b, VReal mask) { return _mm256_blendv_ps(a, b, mask); }
+SIMD_INLINE int VMask(VReal mask) { return _mm256_movemask_ps(mask); }
+
+// Lanes where values[k] > than
+SIMD_INLINE VReal VIntGreater(const int *values, int than)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i *)values);
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(than)));
+}
+
+// Masked with every lane on, the plain gather's undefined source trips
+// -Wmaybe-uninitialized
+SIMD_INLINE VReal VGather(const Real *base, const int *index)
+{
+    return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, _mm256_loadu_si256((const __m256i *)index), VTrue(), 4);
+}
+
+// Lanes outside mask come back as zero
+SIMD_INLINE VReal VGather(const Real *base, const int *index, VReal mask)
+{
+    return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, _mm256_loadu_si256((const __m256i *)index), mask, 4);
+}
+
+// Points of simdWidth consecutive constraints, stored at 2 * c + j, split
+// into one vector per point slot and back
+SIMD_INLINE void VLoadPoints(const Real *p, VReal *first, VReal *second)
+{
+    __m256 lo = _mm256_loadu_ps(p);
+    __m256 hi = _mm256_loadu_ps(p + 8);
+    __m256 even = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 odd = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+    *first = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), 0xD8));
+    *second = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(odd), 0xD8));
+}
+
+SIMD_INLINE void VStorePoints(Real *p, VReal first, VReal second)
+{
+    __m256 lo = _mm256_unpacklo_ps(first, second);
+    __m256 hi = _mm256_unpackhi_ps(first, second);
+    _mm256_storeu_ps(p, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+#else
+
+typedef __m256d VReal;
+const int simdWidth = 4;
+
+SIMD_INLINE VReal VSet(Real a) { return _mm256_set1_pd(a); }
+SIMD_INLINE VReal VZero(void) { return _mm256_setzero_pd(); }
+SIMD_INLINE VReal VTrue(void) { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+SIMD_INLINE VReal VLoad(const Real *p) { return _mm256_loadu_pd(p); }
+SIMD_INLINE void VStore(Real *p, VReal a) { _mm256_storeu_pd(p, a); }
+SIMD_INLINE VReal VAdd(VReal a, VReal b) { return _mm256_add_pd(a, b); }
+SIMD_INLINE VReal VSub(VReal a, VReal b) { return _mm256_sub_pd(a, b); }
+SIMD_INLINE VReal VMul(VReal a, VReal b) { return _mm256_mul_pd(a, b); }
+SIMD_INLINE VReal VDiv(VReal a, VReal b) { return _mm256_div_pd(a, b); }
+SIMD_INLINE VReal VMax(VReal a, VReal b) { return _mm256_max_pd(a, b); }
+SIMD_INLINE VReal VSqrt(VReal a) { return _mm256_sqrt_pd(a); }
+SIMD_INLINE VReal VAnd(VReal a, VReal b) { return _mm256_and_pd(a, b); }
+SIMD_INLINE VReal VAndNot(VReal a, VReal b) { return _mm256_andnot_pd(a, b); }
+SIMD_INLINE VReal VOr(VReal a, VReal b) { return _mm256_or_pd(a, b); }
+SIMD_INLINE VReal VXor(VReal a, VReal b) { return _mm256_xor_pd(a, b); }
+SIMD_INLINE VReal VLess(VReal a, VReal b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+SIMD_INLINE VReal VGreater(VReal a, VReal b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+SIMD_INLINE VReal VEqual(VReal a, VReal b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+SIMD_INLINE VReal VBlend(VReal a, VReal b, VReal mask) { return _mm256_blendv_pd(a, b, mask); }
+SIMD_INLINE int VMask(VReal mask) { return _mm256_movemask_pd(mask); }
+
+// Lanes where values[k] > than
+SIMD_INLINE VReal VIntGreater(const int *values, int than)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)values);
+    return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpgt_epi32(v, _mm_set1_epi32(than))));
+}
+
+// Masked with every lane on, the plain gather's undefined source trips
+// -Wmaybe-uninitialized
+SIMD_INLINE VReal VGather(const Real *base, const int *index)
+{
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm_loadu_si128((const __m128i *)index), VTrue(), 8);
+}
+
+// Lanes outside mask come back as zero
+SIMD_INLINE VReal VGather(const Real *base, const int *index, VReal mask)
+{
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm_loadu_si128((const __m128i *)index), mask, 8);
+}
+
+// Points of simdWidth consecutive constraints, stored at 2 * c + j, split
+// into one vector per point slot and back
+SIMD_INLINE void VLoadPoints(const Real *p, VReal *first, VReal *second)
+{
+    __m256d lo = _mm256_loadu_pd(p);
+    __m256d hi = _mm256_loadu_pd(p + 4);
+    *first = _mm256_permute4x64_pd(_mm256_unpacklo_pd(lo, hi), 0xD8);
+    *second = _mm256_permute4x64_pd(_mm256_unpackhi_pd(lo, hi), 0xD8);
+}
+
+SIMD_INLINE void VStorePoints(Real *p, VReal first, VReal second)
+{
+    __m256d a = _mm256_permute4x64_pd(first, 0xD8);
+    __m256d b = _mm256_permute4x64_pd(second, 0xD8);
+    _mm256_storeu_pd(p, _mm256_unpacklo_pd(a, b));
+    _mm256_storeu_pd(p + 4, _mm256_unpackhi_pd(a, b));
+}
+
+#endif // PHYSICS_FLOAT
+
+#endif // SIMD_X86
+
+#endif // SIMD_H
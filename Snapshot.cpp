@@ -0,0 +1,49 @@
+#include "precompiled.h"
+
+void Snapshot::Clear(void)
+{
+    bodies.clear();
+    vertices.clear();
+    contacts.clear();
+}
+
+void Snapshot::AddBodies(const BodyStore &store)
+{
+    for (int i = 0; i < store.Count(); ++i)
+    {
+        const Body *b = store.records[i];
+        SnapshotBody s;
+        s.id = b->id;
+        s.position = store.position[i];
+        s.rotation = store.rotation[i];
+        s.previousPosition = store.previousPosition[i];
+        s.previousRotation = store.previousRotation[i];
+        s.radius = b->shape->radius;
+        s.firstVertex = vertices.size();
+        s.vertexCount = 0;
+        s.r = b->r;
+        s.g = b->g;
+        s.b = b->b;
+
+        if (b->shape->type != Shape::eCircle)
+        {
+            const PolygonShape *poly = static_cast<const PolygonShape *>(b->shape);
+            s.vertexCount = poly->m_vertexCount;
+            vertices.insert(vertices.end(), poly->m_vertices, poly->m_vertices + poly->m_vertexCount);
+        }
+        bodies.push_back(s);
+    }
+}
+
+void SnapshotBuffer::Publish(void)
+{
+    // Hand the filled slot over and take back whichever one was waiting
+    m_back = m_ready.exchange(m_back | freshBit, std::memory_order_acq_rel) & slotMask;
+}
+
+const Snapshot &SnapshotBuffer::Front(void)
+{
+    if (m_ready.load(std::memory_order_relaxed) & freshBit)
+        m_front = m_ready.exchange(m_front, std::memory_order_acq_rel) & slotMask;
+    return m_slots[m_front];
+}
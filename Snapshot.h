@@ -0,0 +1,77 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "precompiled.h"
+
+// One body as Scene::Render draws it
+struct SnapshotBody
+{
+    unsigned id;
+    Vec position;
+    Rotor rotation;
+    Vec previousPosition; // Before the last step
+    Rotor previousRotation;
+    Real radius;     // Circles
+    int firstVertex; // Polygons, model space vertices in Snapshot::vertices
+    int vertexCount; // Zero for circles
+    Real r, g, b;
+};
+
+struct SnapshotContact
+{
+    Vec point;
+    Vec normal;
+};
+
+// Everything Render needs, copied out of the scene by Scene::Publish so
+// drawing never reads state the stepping thread is changing
+struct Snapshot
+{
+    Snapshot()
+        : step(0), dt(0), remainder(0)
+    {
+    }
+
+    void Clear(void);
+
+    // Appends every body in store
+    void AddBodies(const BodyStore &store);
+
+    std::vector<SnapshotBody> bodies; // Statics first
+    std::vector<Vec> vertices;
+    std::vector<SnapshotContact> contacts;
+    unsigned step; // Scene steps taken when this was published
+    Real dt;
+    Real remainder; // Time the caller had left over past the last step
+    std::chrono::steady_clock::time_point time; // When it was published
+};
+
+// Three snapshots passed from one writer to one reader without locks. The
+// writer fills Back and publishes it, the reader takes the newest published
+// one with Front. Neither side ever waits on the other, a reader that falls
+// behind skips snapshots and a writer that falls behind is drawn again.
+struct SnapshotBuffer
+{
+    SnapshotBuffer()
+        : m_back(0), m_front(1), m_ready(2)
+    {
+    }
+
+    // Writer side
+    Snapshot &Back(void) { return m_slots[m_back]; }
+    void Publish(void);
+
+    // Reader side, the same snapshot until a newer one is published
+    const Snapshot &Front(void);
+
+private:
+    static const int freshBit = 4; // Set on m_ready until the reader takes it
+    static const int slotMask = 3;
+
+    Snapshot m_slots[3];
+    int m_back;               // Only touched by the writer
+    int m_front;              // Only touched by the reader
+    std::atomic<int> m_ready; // Last published slot
+};
+
+#endif // SNAPSHOT_H
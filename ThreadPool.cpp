@@ -0,0 +1,112 @@
+#include "precompiled.h"
+
+ThreadPool::ThreadPool(int threadCount)
+    : m_queues(std::max(threadCount, 1)), m_generation(0), m_quit(false), m_task(NULL), m_pending(0)
+{
+    for (int i = 1; i < m_queues.size(); ++i)
+        m_threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (int i = 0; i < m_threads.size(); ++i)
+        m_threads[i].join();
+}
+
+void ThreadPool::Run(int count, const Task &task)
+{
+    if (count == 0)
+        return;
+
+    if (m_threads.empty())
+    {
+        for (int i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    // Publish the task before any of its items can be taken
+    m_task = &task;
+    m_pending.store(count, std::memory_order_relaxed);
+
+    // Deal the items out round robin, callers put their heaviest tasks first
+    int threadCount = m_queues.size();
+    for (int i = 0; i < threadCount; ++i)
+    {
+        Queue &q = m_queues[i];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        for (int j = i; j < count; j += threadCount)
+            q.items.push_back(j);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    Work(0);
+    while (m_pending.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+}
+
+void ThreadPool::WorkerLoop(int worker)
+{
+    unsigned seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+            if (m_quit)
+                return;
+            seen = m_generation;
+        }
+        Work(worker);
+    }
+}
+
+void ThreadPool::Work(int worker)
+{
+    int item;
+    while (Pop(worker, &item))
+    {
+        (*m_task)(item);
+        m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool ThreadPool::Pop(int worker, int *item)
+{
+    // Own queue first, in the order items were dealt
+    {
+        Queue &q = m_queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.items.empty())
+        {
+            *item = q.items.front();
+            q.items.pop_front();
+            return true;
+        }
+    }
+
+    // Then steal the lightest work from the back of the others
+    int threadCount = m_queues.size();
+    for (int i = 1; i < threadCount; ++i)
+    {
+        Queue &q = m_queues[(worker + i) % threadCount];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.items.empty())
+        {
+            *item = q.items.back();
+            q.items.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "precompiled.h"
+
+// Fixed set of worker threads sharing batches of indexed tasks. Every worker
+// owns a queue it takes from the front of, and steals from the back of the
+// other queues when its own runs dry. The thread calling Run works as
+// worker 0, so a pool of one thread runs everything inline.
+struct ThreadPool
+{
+    typedef std::function<void(int)> Task;
+
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    int GetThreadCount(void) const { return m_queues.size(); }
+
+    // Calls task(i) for every i below count and returns once all have finished
+    void Run(int count, const Task &task);
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<int> items;
+    };
+
+    void WorkerLoop(int worker);
+    void Work(int worker);
+    bool Pop(int worker, int *item);
+
+    std::vector<Queue> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    unsigned m_generation; // Bumped by every Run to wake the workers
+    bool m_quit;
+
+    const Task *m_task;
+    std::atomic<int> m_pending; // Tasks of the current Run not yet finished
+};
+
+#endif // THREADPOOL_H
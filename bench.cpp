@@ -0,0 +1,415 @@
+// Microbenchmarks for the engine's hot kernels, build next to main.cpp:
+//   g++ -O2 bench.cpp -o bench -lsimple2d -pthread
+// and once more with -DPHYSICS_FLOAT to compare against single precision
+#include "precompiled.h"
+
+using namespace std;
+
+static double NanosecondsPer(Clock &clock, long long count)
+{
+    return (double)clock.Difference() / (double)count;
+}
+
+// CircletoCircle one pair at a time against the SoA batch kernels
+void BenchCircleContacts(int bodyCount, int pairCount, int repeats)
+{
+    BodyStore store;
+    vector<Body *> &bodies = store.records;
+    vector<Real> x, y, radius;
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        Circle c(Random(5.0, 20.0));
+        Body *b = store.Add(&c, (i % 100) * 20, (i / 100) * 20);
+        b->index = i;
+        x.push_back(store.position[i].x);
+        y.push_back(store.position[i].y);
+        radius.push_back(c.radius);
+    }
+
+    vector<int> ia(pairCount), ib(pairCount), hit(pairCount);
+    vector<Real> penetration(pairCount), nx(pairCount), ny(pairCount), cx(pairCount), cy(pairCount);
+    for (int i = 0; i < pairCount; ++i)
+    {
+        // Nearby bodies, like a broadphase would report
+        ia[i] = i % bodyCount;
+        ib[i] = (ia[i] + (rand() % 2 ? 1 : 100)) % bodyCount;
+    }
+
+    Clock clock;
+    int touching = 0;
+
+    clock.Start();
+    for (int r = 0; r < repeats; ++r)
+        for (int i = 0; i < pairCount; ++i)
+        {
+            Manifold m(bodies[ia[i]], bodies[ib[i]]);
+            CircletoCircle(&m, m.A, m.B);
+            touching += m.contact_count;
+        }
+    clock.Stop();
+    double perPair = NanosecondsPer(clock, (long long)repeats * pairCount);
+    printf("circle contacts, %d pairs, %d touching\n", pairCount, touching / repeats);
+    printf("  CircletoCircle        %7.2f ns/pair\n", perPair);
+
+    struct
+    {
+        const char *name;
+        CircleContactsFn fn;
+    } kernels[] = {
+        {"CircleContactsScalar", CircleContactsScalar},
+        {"CircleContactsAVX2", CircleContactsAVX2},
+    };
+
+    for (int k = 0; k < 2; ++k)
+    {
+        if (kernels[k].fn == CircleContactsAVX2 && SelectCircleContacts() != CircleContactsAVX2)
+        {
+            printf("  %-22s skipped, no AVX2\n", kernels[k].name);
+            continue;
+        }
+
+        clock.Start();
+        for (int r = 0; r < repeats; ++r)
+            kernels[k].fn(&x[0], &y[0], &radius[0], &ia[0], &ib[0], pairCount,
+                          &penetration[0], &nx[0], &ny[0], &cx[0], &cy[0], &hit[0]);
+        clock.Stop();
+        double ns = NanosecondsPer(clock, (long long)repeats * pairCount);
+        printf("  %-22s %7.2f ns/pair (%.2fx)\n", kernels[k].name, ns, perPair / ns);
+    }
+}
+
+// Per body work of a step, mixed circles and boxes in random order
+void BenchIntegrate(int bodyCount, int repeats)
+{
+    BodyStore store;
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        Body *b;
+        if (rand() % 2)
+        {
+            Circle c(Random(5.0, 20.0));
+            b = store.Add(&c, (i % 100) * 20, (i / 100) * 20);
+        }
+        else
+        {
+            PolygonShape box;
+            box.SetBox(Random(5.0, 20.0), Random(5.0, 20.0));
+            b = store.Add(&box, (i % 100) * 20, (i / 100) * 20);
+        }
+        b->Velocity().Set(Random(-50.0, 50.0), Random(-50.0, 50.0));
+        b->AngularVelocity() = Random(-1.0, 1.0);
+    }
+
+    printf("integrate, %d bodies\n", bodyCount);
+
+    Clock clock;
+    clock.Start();
+    for (int r = 0; r < repeats; ++r)
+        for (int i = 0; i < bodyCount; ++i)
+            IntegrateVelocity(store, i, dt);
+    clock.Stop();
+    printf("  IntegrateVelocity      %7.2f ns/body\n", NanosecondsPer(clock, (long long)repeats * bodyCount));
+
+    double extent = 0;
+    clock.Start();
+    for (int r = 0; r < repeats; ++r)
+        for (int i = 0; i < bodyCount; ++i)
+        {
+            store.records[i]->shape->UpdateGeometry();
+            extent += store.bounds[i].max.x - store.bounds[i].min.x;
+        }
+    clock.Stop();
+    printf("  UpdateGeometry         %7.2f ns/body (%g)\n", NanosecondsPer(clock, (long long)repeats * bodyCount), extent);
+}
+
+// One color's worth of contact constraints, scalar passes against AVX2 lanes
+void BenchContactSolver(int constraintCount, int repeats)
+{
+    int bodyCount = constraintCount * 2;
+    ContactSolver solver;
+    solver.Resize(bodyCount, constraintCount);
+
+    vector<Real> vx(bodyCount), vy(bodyCount), w(bodyCount);
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        vx[i] = Random(-50.0, 50.0);
+        vy[i] = Random(-50.0, 50.0);
+        w[i] = Random(-1.0, 1.0);
+        solver.im[i] = 1.0 / Random(1.0, 10.0);
+        solver.iI[i] = solver.im[i] / Random(50.0, 200.0);
+    }
+
+    // Every body appears once, a quarter of the pairs rest on a static
+    for (int c = 0; c < constraintCount; ++c)
+    {
+        solver.bodyA[c] = c % 4 == 0 ? -1 : 2 * c;
+        solver.bodyB[c] = 2 * c + 1;
+        solver.pointCount[c] = rand() % 2 + 1;
+        double angle = Random(-PI, PI);
+        solver.nx[c] = cos(angle);
+        solver.ny[c] = sin(angle);
+        solver.staticFriction[c] = 0.5;
+        solver.dynamicFriction[c] = 0.3;
+        for (int j = 0; j < 2; ++j)
+        {
+            int p = 2 * c + j;
+            solver.rax[p] = Random(-10.0, 10.0);
+            solver.ray[p] = Random(-10.0, 10.0);
+            solver.rbx[p] = Random(-10.0, 10.0);
+            solver.rby[p] = Random(-10.0, 10.0);
+            solver.bias[p] = 0;
+
+            // Effective masses the way Manifold::Initialize computes them
+            int a = solver.bodyA[c];
+            int b = solver.bodyB[c];
+            Real ima = a < 0 ? 0 : solver.im[a], iia = a < 0 ? 0 : solver.iI[a];
+            Real raN = solver.rax[p] * solver.ny[c] - solver.ray[p] * solver.nx[c];
+            Real rbN = solver.rbx[p] * solver.ny[c] - solver.rby[p] * solver.nx[c];
+            Real raT = -solver.rax[p] * solver.nx[c] - solver.ray[p] * solver.ny[c];
+            Real rbT = -solver.rbx[p] * solver.nx[c] - solver.rby[p] * solver.ny[c];
+            solver.normalMass[p] = 1.0 / (ima + solver.im[b] + raN * raN * iia + rbN * rbN * solver.iI[b]);
+            solver.tangentMass[p] = 1.0 / (ima + solver.im[b] + raT * raT * iia + rbT * rbT * solver.iI[b]);
+        }
+    }
+
+    printf("contact solver, %d constraints\n", constraintCount);
+
+    solver.SetWide(true);
+    vector<Real> result[2];
+    double scalarNs = 0;
+    for (int k = 0; k < 2; ++k)
+    {
+        if (k == 1 && !solver.wide)
+        {
+            printf("  SolveWide              skipped, no AVX2\n");
+            break;
+        }
+
+        for (int i = 0; i < bodyCount; ++i)
+        {
+            solver.vx[i] = vx[i];
+            solver.vy[i] = vy[i];
+            solver.w[i] = w[i];
+        }
+        fill(solver.normalImpulse.begin(), solver.normalImpulse.end(), Real(0));
+        fill(solver.tangentImpulse.begin(), solver.tangentImpulse.end(), Real(0));
+
+        Clock clock;
+        clock.Start();
+        for (int r = 0; r < repeats; ++r)
+        {
+            if (k == 0)
+                solver.Solve(0, constraintCount);
+            else
+                solver.SolveWide(0, constraintCount);
+        }
+        clock.Stop();
+        double ns = NanosecondsPer(clock, (long long)repeats * constraintCount);
+        if (k == 0)
+        {
+            scalarNs = ns;
+            printf("  Solve                  %7.2f ns/constraint\n", ns);
+        }
+        else
+            printf("  SolveWide              %7.2f ns/constraint (%.2fx)\n", ns, scalarNs / ns);
+        result[k] = solver.vx;
+    }
+
+    if (solver.wide)
+    {
+        double diff = 0;
+        for (int i = 0; i < bodyCount; ++i)
+            diff = max(diff, (double)abs(result[0][i] - result[1][i]));
+        printf("  largest velocity difference %g\n", diff);
+    }
+}
+
+// Boxes and circles dropped into a bin, they settle into one pile big enough
+// to be solved by color
+static void AddPile(Scene &scene, int bodyCount)
+{
+    PolygonShape wall;
+    wall.SetBox(1000, 10);
+    scene.AddStatic(&wall, 500, 1000, 0);
+    wall.SetBox(10, 1000);
+    scene.AddStatic(&wall, 0, 500, 0);
+    scene.AddStatic(&wall, 1000, 500, 0);
+
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        int x = 30 + (i % 40) * 23;
+        int y = 950 - (i / 40) * 23;
+        if (i % 2)
+        {
+            Circle c(Random(6.0, 10.0));
+            scene.Add(&c, x, y);
+        }
+        else
+        {
+            PolygonShape box;
+            box.SetBox(Random(6.0, 10.0), Random(6.0, 10.0));
+            scene.Add(&box, x, y);
+        }
+    }
+}
+
+// Whole steps of a settling pile, compare builds with and without
+// PHYSICS_FLOAT
+void BenchStep(int bodyCount, int steps)
+{
+    Scene scene(1.0f / 60.0f, 10);
+    AddPile(scene, bodyCount);
+
+    printf("step, %d bodies, %s, sizeof Body %d Manifold %d\n", bodyCount,
+           sizeof(Real) == sizeof(float) ? "float" : "double", (int)sizeof(Body), (int)sizeof(Manifold));
+
+    Clock clock;
+    clock.Start();
+    for (int i = 0; i < steps; ++i)
+        scene.Step();
+    clock.Stop();
+    double ns = NanosecondsPer(clock, steps);
+    printf("  Scene::Step            %7.1f steps/s, %d contacts\n", 1e9 / ns, (int)scene.contacts.size());
+}
+
+// Free falling bodies that never touch, so a step is almost all per body
+// work: broadphase, integration and geometry updates
+void BenchParallelStep(int bodyCount, int steps)
+{
+    printf("parallel step, %d separate bodies\n", bodyCount);
+    int threadCounts[] = {1, 2, 4};
+    for (int t = 0; t < 3; ++t)
+    {
+        Scene scene(1.0f / 60.0f, 10);
+        scene.SetThreadCount(threadCounts[t]);
+        for (int i = 0; i < bodyCount; ++i)
+        {
+            Circle c(5.0);
+            scene.Add(&c, (i % 250) * 30, (i / 250) * 30);
+        }
+
+        long long solveTime = 0;
+        Clock clock;
+        clock.Start();
+        for (int i = 0; i < steps; ++i)
+        {
+            scene.Step();
+            solveTime += scene.stats.solveTime;
+        }
+        clock.Stop();
+        double ns = NanosecondsPer(clock, steps);
+        printf("  %d threads              %7.1f steps/s, islands %.2f ms/step\n",
+               threadCounts[t], 1e9 / ns, solveTime / (steps * 1e6));
+    }
+}
+
+// Bytes of every dynamic body's state, FNV-1a
+// Stacks of three boxes standing apart, each an island of three contacts,
+// too small for coloring. Wide mode has to pack their constraints across
+// islands to use SolveWide at all. Every pass runs, so the impulse loop
+// dominates the solve.
+void BenchWideIslands(int stackCount, int steps)
+{
+    printf("small islands, %d stacks of 3 boxes\n", stackCount);
+    double scalar = 0;
+    for (int wide = 0; wide < 2; ++wide)
+    {
+        Scene scene(1.0f / 60.0f, 10);
+        scene.SetAllowSleep(false);
+        scene.SetTolerance(0);
+        scene.solver.SetWide(wide != 0);
+        if (wide && !scene.solver.wide)
+        {
+            printf("  SolveWide               no AVX2\n");
+            break;
+        }
+
+        PolygonShape floor;
+        floor.SetBox(stackCount * 15 + 20, 10);
+        scene.AddStatic(&floor, stackCount * 15, 700, 0);
+        for (int i = 0; i < stackCount; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                PolygonShape box;
+                box.SetBox(10, 10);
+                Body *b = scene.GetBody(scene.Add(&box, 15 + i * 30, 680 - j * 20));
+                b->SetOrient(0);
+                b->restitution = 0;
+            }
+        }
+
+        long long solveTime = 0;
+        for (int i = 0; i < steps; ++i)
+        {
+            scene.Step();
+            solveTime += scene.stats.solveTime;
+        }
+        double ms = solveTime / (steps * 1e6);
+        if (!wide)
+            scalar = ms;
+        printf("  %-22s %7.2f ms/step solving (%.2fx), %d islands\n", wide ? "SolveWide" : "Solve",
+               ms, scalar / ms, scene.stats.islandCount);
+    }
+}
+
+static unsigned long long HashBodies(const BodyStore &store)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    auto mix = [&](const void *data, int size) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (int i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+    for (int i = 0; i < store.Count(); ++i)
+    {
+        mix(&store.position[i], sizeof(Vec));
+        mix(&store.velocity[i], sizeof(Vec));
+        mix(&store.rotation[i], sizeof(Rotor));
+        mix(&store.angularVelocity[i], sizeof(Real));
+    }
+    return hash;
+}
+
+// The same pile stepped in deterministic mode under several pool setups.
+// Returns false if any run ended somewhere else.
+bool CheckDeterminism(int bodyCount, int steps)
+{
+    printf("determinism, %d bodies, %d steps\n", bodyCount, steps);
+    int setups[][2] = {{1, 64}, {2, 64}, {4, 64}, {4, 16}, {3, 7}}; // Threads, batch size
+    unsigned long long first = 0;
+    bool same = true;
+    for (int k = 0; k < 5; ++k)
+    {
+        srand(1);
+        Scene scene(1.0f / 60.0f, 10);
+        scene.SetThreadCount(setups[k][0]);
+        scene.SetBatchSize(setups[k][1]);
+        scene.SetDeterministic(true);
+        scene.solver.SetWide(true);
+        AddPile(scene, bodyCount);
+
+        for (int i = 0; i < steps; ++i)
+            scene.Step();
+
+        unsigned long long hash = HashBodies(scene.bodies);
+        if (k == 0)
+            first = hash;
+        same = same && hash == first;
+        printf("  %d threads, batch %-3d   %016llx%s\n", setups[k][0], setups[k][1], hash,
+               hash == first ? "" : " MISMATCH");
+    }
+    return same;
+}
+
+int main(int argc, char const *argv[])
+{
+    srand(1);
+    BenchCircleContacts(10000, 100000, 50);
+    BenchIntegrate(10000, 200);
+    BenchContactSolver(10000, 200);
+    BenchStep(1000, 300);
+    BenchParallelStep(50000, 60);
+    BenchWideIslands(2000, 120);
+    return CheckDeterminism(800, 300) ? 0 : 1;
+}
@@ -1,26 +1,42 @@
 #include "precompiled.h"
 
-Body::Body(Shape *shape_, int x, int y)
-    : shape(shape_->Clone())
+// The store has already made room for slot_ and copied the shape
+Body::Body(BodyStore *store_, int slot_, Shape *shape_, int x, int y)
+    : store(store_), slot(slot_), shape(shape_)
 {
     shape->body = this;
-    position.Set((double)x, (double)y);
-    velocity.Set(0, 0);
-    angularVelocity = 0;
-    torque = 0;
-    orient = Random(-PI, PI);
-    force.Set(0, 0);
+    Position().Set((Real)x, (Real)y);
+    Velocity().Set(0, 0);
+    AngularVelocity() = 0;
+    Torque() = 0;
+    store->rotation[slot] = Rotor(Random(-PI, PI));
+    Force().Set(0, 0);
     staticFriction = 0.5;
     dynamicFriction = 0.5;
     restitution = 1.0;
     shape->Initialize();
+    shape->UpdateGeometry();
+    shapeType = shape->GetType();
     r = Random(0.2, 1.0);
     g = Random(0.2, 1.0);
     b = Random(0.2, 1.0);
+    id = 0;
+    proxyId = -1;
+    index = -1;
+    awake = true;
+    sleepTime = 0;
+    island = -1;
 }
 
-void Body::SetOrient(double radians)
+void Body::SetOrient(Real radians)
 {
-    orient = radians;
-    shape->SetOrient(radians);
-}
\ No newline at end of file
+    SetRotation(Rotor(radians));
+}
+
+void Body::SetRotation(const Rotor &q)
+{
+    store->rotation[slot] = q;
+    store->previousRotation[slot] = q; // Placed, not swept there
+    shape->UpdateGeometry();
+}
+
@@ -3,44 +3,80 @@
 
 struct Shape;
 
+// A body's record in its BodyStore. Position, velocity, orientation and the
+// accumulated force live in the store's arrays at slot, the accessors below
+// reach them through store. The shape's world space geometry and Bounds()
+// are cached once per step, a body moved by hand between steps needs
+// shape->UpdateGeometry() before the next one.
 struct Body
 {
-    Vec position;
-    Vec velocity;
+    BodyStore *store;
+    int slot; // Dense slot in store, moves if another body is removed
 
-    double angularVelocity;
-    double torque;
-    double orient; // radians
-
-    Vec force;
+    Vec &Position(void) { return store->position[slot]; }
+    Vec &Velocity(void) { return store->velocity[slot]; }
+    Vec &Force(void) { return store->force[slot]; }
+    Real &AngularVelocity(void) { return store->angularVelocity[slot]; }
+    Real &Torque(void) { return store->torque[slot]; }
+    const Vec &Position(void) const { return store->position[slot]; }
+    const Vec &Velocity(void) const { return store->velocity[slot]; }
+    const Vec &Force(void) const { return store->force[slot]; }
+    Real AngularVelocity(void) const { return store->angularVelocity[slot]; }
+    Real Torque(void) const { return store->torque[slot]; }
+    const Rotor &Rotation(void) const { return store->rotation[slot]; }
+    const AABB &Bounds(void) const { return store->bounds[slot]; }
+    Real Orient(void) const { return Rotation().Angle(); } // radians
 
     // Set by shape
-    double I;  // moment of inertia
-    double iI; // inverse inertia
-    double m;  // mass
-    double im; // inverse mass
+    Real I;  // moment of inertia
+    Real iI; // inverse inertia
+    Real m;  // mass
+    Real im; // inverse mass
 
-    double staticFriction;
-    double dynamicFriction;
-    double restitution;
+    Real staticFriction;
+    Real dynamicFriction;
+    Real restitution;
 
     // Shape interface
     Shape *shape;
+    int shapeType; // shape->GetType(), cached for the narrowphase
 
     // Store a color in RGB format
-    double r, g, b;
+    Real r, g, b;
+
+    // Unique per scene, assigned by Scene::Add
+    unsigned id;
+
+    // Handle owned by the scene's broadphase
+    int proxyId;
 
-    Body(Shape *shape_, int x, int y);
+    // Slot in the scene's per step arrays, dynamic bodies first then statics
+    int index;
 
+    // Sleeping bodies are left out of integration and solving until touched
+    bool awake;
+    Real sleepTime;   // Seconds spent below the sleep velocities
+    int island;       // Scene sleeping island slot while asleep, otherwise -1
+
+    Body(BodyStore *store_, int slot_, Shape *shape_, int x, int y);
+
+    // Forces are cleared as each step integrates them. A sleeping body takes
+    // none, wake it through Scene::Wake first.
     void ApplyForce(const Vec &f)
     {
-        force += f;
+        if (!awake)
+            return;
+        Force() += f;
     }
 
     void ApplyImpulse(const Vec &impulse, const Vec &contactVector)
     {
-        velocity += im * impulse;
-        angularVelocity += iI * Cross(contactVector, impulse);
+        // Statics are shared by islands solved on different threads
+        if (im == 0)
+            return;
+
+        Velocity() += im * impulse;
+        AngularVelocity() += iI * Cross(contactVector, impulse);
     }
 
     void SetStatic(void)
@@ -49,9 +85,14 @@ struct Body
         iI = 0.0;
         m = 0.0;
         im = 0.0;
+        store->im[slot] = 0.0;
+        store->iI[slot] = 0.0;
+        awake = false;
     }
 
-    void SetOrient(double radians);
+    // Both refresh the shape's cached geometry
+    void SetOrient(Real radians);
+    void SetRotation(const Rotor &q);
 };
 
 #endif // BODY_H
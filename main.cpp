@@ -3,13 +3,105 @@
 using namespace std;
 
 S2D_Window *window;
-Scene scene(1.0f / 60.0f, 10);
-bool frameStepping = false;
-bool canStep = false;
-Clock g_Clock;
+// Render blends between steps, so the tick needn't match the display rate.
+// Below 60 Hz tall stacks need SetSubsteps to stay up.
+const Real tick = 1.0f / 60.0f;
+Scene scene(tick, 4);
+std::atomic<bool> frameStepping(false);
+std::atomic<bool> canStep(false);
+std::atomic<bool> simulating(true);
+
+// Spawners, posted by on_mouse and run on the simulation thread
+void AddCircle(Scene &s, int mouseX, int mouseY)
+{
+    Circle c(Random(10.0, 80.0));
+    s.Add(&c, mouseX, mouseY);
+}
+
+void AddPolygon(Scene &s, int mouseX, int mouseY)
+{
+    int numVertex = rand() % 2 + 3;
+    cout << numVertex << "\n";
+    PolygonShape poly;
+    Vec *vertices = new Vec[numVertex];
+    double e = 10;
+    for (int i = 0; i < numVertex; ++i)
+    {
+        int x = Random(-e, e);
+        int factor = 40;
+        if (x < 0)
+            x -= factor;
+        else
+            x += factor;
+        int y = Random(-e, e);
+        if (y < 0)
+            y -= factor;
+        else
+            y += factor;
+        cout << x << " " << y << endl;
+        vertices[i].Set(x, y);
+    }
+    poly.Set(vertices, numVertex);
+
+    Body *b = s.GetBody(s.Add(&poly, mouseX, mouseY));
+
+    b->restitution = 1.0;
+    b->dynamicFriction = 0.0;
+    b->staticFriction = 0.0;
+    double radians = Random(0, PI / 3);
+    cout << radians << endl;
+    b->SetOrient(radians);
+    delete[] vertices;
+}
+
+void AddStaticCircle(Scene &s, int mouseX, int mouseY)
+{
+    Circle c(100.0);
+    s.AddStatic(&c, mouseX, mouseY, 0);
+}
+
+void AddStaticPolygon(Scene &s, int mouseX, int mouseY)
+{
+    int numVertex = rand() % 2 + 3;
+    cout << numVertex << "\n";
+    PolygonShape poly;
+    Vec *vertices = new Vec[numVertex];
+    double e = 10;
+    for (int i = 0; i < numVertex; ++i)
+    {
+        int x = Random(-e, e);
+        int factor = 0;
+        if (x < 0)
+            x -= factor;
+        else
+            x += factor;
+        int y = Random(-e, e);
+        if (y < 0)
+            y -= factor;
+        else
+            y += factor;
+        vertices[i].Set(x, y);
+    }
+    vertices[0].Set(-e, e);
+    vertices[0].Set(e, e);
+    vertices[0].Set(-e, -e);
+    vertices[0].Set(e, -e);
+    poly.Set(vertices, numVertex);
+
+    double radians = Random(-PI, PI);
+    cout << radians << endl;
+    s.AddStatic(&poly, mouseX, mouseY, radians);
+
+    delete[] vertices;
+}
 
 void on_mouse(S2D_Event e)
 {
+    // The scene belongs to the simulation thread, only the click position
+    // is read here
+    int x = window->mouse.x;
+    int y = window->mouse.y;
+
     switch (e.type)
     {
     case S2D_MOUSE_UP: // button is released
@@ -17,91 +109,25 @@ void on_mouse(S2D_Event e)
         if (e.button == S2D_MOUSE_LEFT)
         {
             // Draw a circle at that point
-            cout << "Left click at (" << window->mouse.x << ", " << window->mouse.y << ")\n";
-            Circle c(Random(10.0, 80.0));
-            Body *b = scene.Add(&c, window->mouse.x, window->mouse.y);
+            cout << "Left click at (" << x << ", " << y << ")\n";
+            scene.Post([x, y](Scene &s) { AddCircle(s, x, y); });
         }
         else if (e.button == S2D_MOUSE_RIGHT)
         {
             // Draw a polygon
-            int numVertex = rand() % 2 + 3;
-            cout << numVertex << "\n";
-            cout << "Right click at (" << window->mouse.x << ", " << window->mouse.y << ")\n";
-            PolygonShape poly;
-            Vec *vertices = new Vec[numVertex];
-            double e = 10;
-            for (int i = 0; i < numVertex; ++i)
-            {
-                int x = Random(-e, e);
-                int factor = 40;
-                if (x < 0)
-                    x -= factor;
-                else
-                    x += factor;
-                int y = Random(-e, e);
-                if (y < 0)
-                    y -= factor;
-                else
-                    y += factor;
-                cout << x << " " << y << endl;
-                vertices[i].Set(x, y);
-            }
-            poly.Set(vertices, numVertex);
-
-            Body *b = scene.Add(&poly, window->mouse.x, window->mouse.y);
-
-            b->restitution = 1.0;
-            b->dynamicFriction = 0.0;
-            b->staticFriction = 0.0;
-            double radians = Random(0, PI / 3);
-            cout << radians << endl;
-            b->SetOrient(radians);
-            delete[] vertices;
+            cout << "Right click at (" << x << ", " << y << ")\n";
+            scene.Post([x, y](Scene &s) { AddPolygon(s, x, y); });
         }
         else if (e.button == S2D_MOUSE_X1)
         {
             // static circle
-            Circle c(100.0);
-            Body *b = scene.Add(&c, window->mouse.x, window->mouse.y);
-            b->SetStatic();
+            scene.Post([x, y](Scene &s) { AddStaticCircle(s, x, y); });
         }
         else if (e.button == S2D_MOUSE_X2)
         {
             // Draw a polygon
-            int numVertex = rand() % 2 + 3;
-            cout << numVertex << "\n";
-            cout << "Right click at (" << window->mouse.x << ", " << window->mouse.y << ")\n";
-            PolygonShape poly;
-            Vec *vertices = new Vec[numVertex];
-            double e = 10;
-            for (int i = 0; i < numVertex; ++i)
-            {
-                int x = Random(-e, e);
-                int factor = 0;
-                if (x < 0)
-                    x -= factor;
-                else
-                    x += factor;
-                int y = Random(-e, e);
-                if (y < 0)
-                    y -= factor;
-                else
-                    y += factor;
-                vertices[i].Set(x, y);
-            }
-            vertices[0].Set(-e, e);
-            vertices[0].Set(e, e);
-            vertices[0].Set(-e, -e);
-            vertices[0].Set(e, -e);
-            poly.Set(vertices, numVertex);
-
-            Body *b = scene.Add(&poly, window->mouse.x, window->mouse.y);
-            double radians = Random(-PI, PI);
-            cout << radians << endl;
-            b->SetOrient(radians);
-            b->SetStatic();
-
-            delete[] vertices;
+            cout << "Right click at (" << x << ", " << y << ")\n";
+            scene.Post([x, y](Scene &s) { AddStaticPolygon(s, x, y); });
         }
         if (e.dblclick)
             puts("Double click");
@@ -131,37 +157,50 @@ void render()
 {
 }
 
-void update()
+// Fixed steps on a thread of their own, so a slow step never stalls drawing
+// or input and a slow frame never eats into the physics budget
+void simulate()
 {
-    static double accumulator = 0;
-
-    // Different time mechanisms for Linux and Windows
+    Clock clock;
+    double accumulator = 0;
+    clock.Start();
+    while (simulating)
+    {
+        // Different time mechanisms for Linux and Windows
 #ifdef WIN32
-    accumulator += g_Clock.Elapsed();
+        accumulator += clock.Elapsed();
 #else
-    accumulator += g_Clock.Elapsed() / static_cast<double>(std::chrono::duration_cast<clock_freq>(std::chrono::seconds(1)).count());
+        accumulator += clock.Elapsed() / static_cast<double>(std::chrono::duration_cast<clock_freq>(std::chrono::seconds(1)).count());
 #endif
+        clock.Start();
 
-    g_Clock.Start();
+        scene.RunCommands();
 
-    accumulator = Clamp(0.0f, 0.1f, accumulator);
-    while (accumulator >= dt)
-    {
-        if (!frameStepping)
-            scene.Step();
-        else
+        accumulator = Clamp(0.0f, 0.1f, accumulator);
+        while (accumulator >= tick)
         {
-            if (canStep)
-            {
+            if (!frameStepping)
                 scene.Step();
-                canStep = false;
+            else
+            {
+                if (canStep)
+                {
+                    scene.Step();
+                    canStep = false;
+                }
             }
+            accumulator -= tick;
         }
-        accumulator -= dt;
-    }
 
-    g_Clock.Stop();
+        scene.Publish(accumulator);
 
+        // Nothing to do until the next step is due
+        std::this_thread::sleep_for(std::chrono::duration<double>(tick - accumulator));
+    }
+}
+
+void update()
+{
     scene.Render();
 }
 
@@ -171,24 +210,23 @@ int main(int argc, char const *argv[])
     window->viewport.mode = S2D_SCALE;
     window->on_key = on_key;
     window->on_mouse = on_mouse;
+    scene.SetThreadCount(std::thread::hardware_concurrency());
+    scene.solver.SetWide(true);
     PolygonShape poly1;
     poly1.SetBox(window->viewport.width, 1);
-    Body *b1 = scene.Add(&poly1, 0, window->viewport.height-10);
-    b1->SetStatic();
-    b1->SetOrient(0);
+    scene.AddStatic(&poly1, 0, window->viewport.height-10, 0);
     cout<<window->viewport.height<<"\n";
     PolygonShape poly2;
     poly1.SetBox(1, window->viewport.height);
-    Body *b2 = scene.Add(&poly1, 10, 0);
-    b2->SetStatic();
-    b2->SetOrient(0);
+    scene.AddStatic(&poly1, 10, 0, 0);
 
     PolygonShape poly3;
     poly1.SetBox(1, window->viewport.height);
-    Body *b3 = scene.Add(&poly1, window->viewport.width-10, 0);
-    b3->SetOrient(0);
+    scene.AddStatic(&poly1, window->viewport.width-10, 0, 0);
 
-    b3->SetStatic();
+    std::thread simulation(simulate);
     S2D_Show(window);
+    simulating = false;
+    simulation.join();
     return 0;
 }
\ No newline at end of file
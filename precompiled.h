@@ -3,15 +3,38 @@
 
 #include <bits/stdc++.h>
 #include "PMath.h"
+#include "Simd.h"
 #include "Clock.h"
 #include "Clock.cpp"
+#include "Pool.h"
+#include "BodyStore.h"
 #include "body.h"
 #include "shape.h"
 #include "body.cpp"
+#include "Pool.cpp"
+#include "BodyStore.cpp"
+#include "DynamicTree.h"
+#include "DynamicTree.cpp"
+#include "Broadphase.h"
+#include "Broadphase.cpp"
 #include "Collision.h"
 #include "Manifold.h"
+#include "ContactSolver.h"
+#include "GJK.h"
 #include "Collision.cpp"
+#include "GJK.cpp"
 #include "Manifold.cpp"
+#include "ContactSolver.cpp"
+#include "CircleBatch.h"
+#include "CircleBatch.cpp"
+#include "Narrowphase.h"
+#include "Narrowphase.cpp"
+#include "ThreadPool.h"
+#include "ThreadPool.cpp"
+#include "Island.h"
+#include "Island.cpp"
+#include "Snapshot.h"
+#include "Snapshot.cpp"
 #include "Scene.h"
 #include "Scene.cpp"
 
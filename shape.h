@@ -1,54 +1,80 @@
 #ifndef SHAPE_H
 #define SHAPE_H
 
-#include <simple2d.h>
 #include "precompiled.h"
 
+// Polygons up to this size keep their vertices inline, larger hulls are
+// stored on the heap and collide through GJK/EPA
 #define MaxPolyVertexCount 4
 
+// Monotonic in the angle of d over (-pi, pi], without any trig. d must
+// not be zero.
+inline Real PseudoAngle(const Vec &d)
+{
+    Real p = d.x / (std::abs(d.x) + std::abs(d.y));
+    return d.y < 0.0 ? p - 1.0 : 1.0 - p;
+}
+
+// Tagged by type instead of a vtable. Circle and PolygonShape only differ
+// in layout, the operations below switch on type and call the concrete
+// struct's version directly, so the per step calls inline.
 struct Shape
 {
     enum Type
     {
         eCircle,
         ePoly,
+        eHull, // PolygonShape with more than MaxPolyVertexCount vertices
         eCount
     };
+    Type type;
     Body *body;
 
     // For circle shape
-    double radius;
+    Real radius;
 
     // For Polygon shape
-    Mat2 u; // Orientation matrix from model to world
-
-    Shape() {}
-    virtual Shape *Clone(void) const = 0;
-    virtual void Initialize(void) = 0;
-    virtual void ComputeMass(double density) = 0;
-    virtual void SetOrient(double radians) = 0;
-    virtual void Draw(void) const = 0;
-    virtual Type GetType(void) const = 0;
-};
+    Mat2 u; // Orientation matrix from model to world, cached with the geometry
 
-struct Circle : public Shape
-{
-    Circle(double r)
+    Shape(Type type_)
+        : type(type_)
     {
-        radius = r;
     }
 
-    Shape *Clone(void) const
-    {
-        return new Circle(radius);
-    }
+    // Copy constructs into memory, which must hold MaxShapeSize bytes
+    Shape *Clone(void *memory) const;
+
+    // Runs the concrete destructor, the memory stays with the caller
+    void Destroy(void);
 
     void Initialize(void)
     {
         ComputeMass(1.0f);
     }
 
-    void ComputeMass(double density)
+    void ComputeMass(Real density);
+
+    // Recompute the world space geometry and the body's bounds from its
+    // position and rotation, once per step
+    void UpdateGeometry(void);
+
+    void ComputeAABB(AABB *aabb) const;
+
+    Type GetType(void) const
+    {
+        return type;
+    }
+};
+
+struct Circle : public Shape
+{
+    Circle(Real r)
+        : Shape(eCircle)
+    {
+        radius = r;
+    }
+
+    void ComputeMass(Real density)
     {
         body->m = PI * radius * radius * density * 0.0001;
         body->im = (body->m) ? 1.0f / body->m : 0.0f;
@@ -56,48 +82,67 @@ struct Circle : public Shape
         body->iI = (body->I) ? 1.0f / body->I : 0.0f;
     }
 
-    void SetOrient(double radians)
-    {
-    }
-
-    void Draw(void) const
+    void UpdateGeometry(void)
     {
-        S2D_DrawCircle(body->position.x, body->position.y, radius, 100, body->r, body->g, body->b, 1);
+        ComputeAABB(&body->store->bounds[body->slot]);
     }
 
-    Type GetType(void) const
+    void ComputeAABB(AABB *aabb) const
     {
-        return eCircle;
+        aabb->min = body->Position() - Vec(radius, radius);
+        aabb->max = body->Position() + Vec(radius, radius);
     }
 };
 
 struct PolygonShape : public Shape
 {
-    void Initialize(void)
+    PolygonShape()
+        : Shape(ePoly), m_vertexCount(0), m_vertices(m_localVertices), m_normals(m_localNormals),
+          m_worldVertices(m_localWorld), m_worldNormals(m_localWorld + MaxPolyVertexCount), m_supportStart(0)
     {
-        ComputeMass(1.0f);
     }
 
-    Shape *Clone(void) const
+    PolygonShape(const PolygonShape &rhs)
+        : Shape(ePoly), m_vertexCount(0), m_vertices(m_localVertices), m_normals(m_localNormals),
+          m_worldVertices(m_localWorld), m_worldNormals(m_localWorld + MaxPolyVertexCount), m_supportStart(0)
     {
-        PolygonShape *poly = new PolygonShape();
-        poly->u = u;
+        *this = rhs;
+    }
+
+    PolygonShape &operator=(const PolygonShape &rhs)
+    {
+        if (this == &rhs)
+            return *this;
+
+        body = rhs.body;
+        radius = rhs.radius;
+        u = rhs.u;
+        Reserve(rhs.m_vertexCount);
         for (int i = 0; i < m_vertexCount; ++i)
         {
-            poly->m_vertices[i] = m_vertices[i];
-            poly->m_normals[i] = m_normals[i];
+            m_vertices[i] = rhs.m_vertices[i];
+            m_normals[i] = rhs.m_normals[i];
         }
-        poly->m_vertexCount = m_vertexCount;
-        return poly;
+        if (m_worldVertices)
+        {
+            for (int i = 0; i < m_vertexCount; ++i)
+            {
+                m_worldVertices[i] = rhs.m_worldVertices[i];
+                m_worldNormals[i] = rhs.m_worldNormals[i];
+            }
+        }
+        m_supportKeys = rhs.m_supportKeys;
+        m_supportStart = rhs.m_supportStart;
+        return *this;
     }
 
-    void ComputeMass(double density)
+    void ComputeMass(Real density)
     {
         // Calculate centroid and moment of interia
         Vec c(0.0f, 0.0f); // centroid
-        double area = 0.0f;
-        double I = 0.0f;
-        const double k_inv3 = 1.0f / 3.0f;
+        Real area = 0.0f;
+        Real I = 0.0f;
+        const Real k_inv3 = 1.0f / 3.0f;
 
         for (int i1 = 0; i1 < m_vertexCount; ++i1)
         {
@@ -106,16 +151,16 @@ struct PolygonShape : public Shape
             int i2 = i1 + 1 < m_vertexCount ? i1 + 1 : 0;
             Vec p2(m_vertices[i2]);
 
-            double D = Cross(p1, p2);
-            double triangleArea = 0.5f * D;
+            Real D = Cross(p1, p2);
+            Real triangleArea = 0.5f * D;
 
             area += triangleArea;
 
             // Use area to weight the centroid average, not just vertex position
             c += triangleArea * k_inv3 * (p1 + p2);
 
-            double intx2 = p1.x * p1.x + p2.x * p1.x + p2.x * p2.x;
-            double inty2 = p1.y * p1.y + p2.y * p1.y + p2.y * p2.y;
+            Real intx2 = p1.x * p1.x + p2.x * p1.x + p2.x * p2.x;
+            Real inty2 = p1.y * p1.y + p2.y * p1.y + p2.y * p2.y;
             I += (0.25f * k_inv3 * D) * (intx2 + inty2);
         }
 
@@ -133,63 +178,50 @@ struct PolygonShape : public Shape
         body->iI = body->I ? 1.0f / body->I : 0.0f;
     }
 
-    void SetOrient(double radians)
-    {
-        u.Set(radians);
-    }
-
-    void Draw(void) const
+    // Large hulls keep no world copy, refreshing all of it every step would
+    // cost O(n) and undo their O(log n) support queries
+    void UpdateGeometry(void)
     {
-        
-        if (m_vertexCount == 3)
+        u.Set(body->Rotation());
+        if (m_worldVertices)
         {
-            Vec v[m_vertexCount];
-            for (int i = 0; i < m_vertexCount; i++)
+            Vec p = body->Position();
+            for (int i = 0; i < m_vertexCount; ++i)
             {
-                v[i] = body->position + u * m_vertices[i];
+                m_worldVertices[i] = u * m_vertices[i] + p;
+                m_worldNormals[i] = u * m_normals[i];
             }
-            S2D_DrawTriangle(
-                v[0].x, v[0].y, body->r, body->g, body->b, 1,
-                v[1].x, v[1].y, body->r, body->g, body->b, 1,
-                v[2].x, v[2].y, body->r, body->g, body->b, 1);
-            // std::cout<<"----------------"<<std::endl;
-            // std::cout<<v[0].x<<" "<<v[0].y<<std::endl;
-            // std::cout<<v[1].x<<" "<<v[1].y<<std::endl;
-            // std::cout<<v[2].x<<" "<<v[2].y<<std::endl;
-            // std::cout<<"----------------"<<std::endl;
-
-        }
-        else if (m_vertexCount == 4)
-        {
-            Vec v[m_vertexCount];
-            for (int i = 0; i < m_vertexCount; i++)
-            {
-                v[i] = body->position + u * m_vertices[i];
-            }
-            S2D_DrawQuad(
-                v[0].x, v[0].y, body->r, body->g, body->b, 1,
-                v[1].x, v[1].y, body->r, body->g, body->b, 1,
-                v[2].x, v[2].y, body->r, body->g, body->b, 1,
-                v[3].x, v[3].y, body->r, body->g, body->b, 1);
-
-            // std::cout<<"----------------"<<std::endl;
-            // std::cout<<v[0].x<<" "<<v[0].y<<std::endl;
-            // std::cout<<v[1].x<<" "<<v[1].y<<std::endl;
-            // std::cout<<v[2].x<<" "<<v[2].y<<std::endl;
-            // std::cout<<v[3].x<<" "<<v[3].y<<std::endl;
-            // std::cout<<"----------------"<<std::endl;
         }
+        ComputeAABB(&body->store->bounds[body->slot]);
     }
 
-    Type GetType(void) const
+    void ComputeAABB(AABB *aabb) const
     {
-        return ePoly;
+        if (!m_worldVertices)
+        {
+            // Support points along the world axes, turned into model space
+            Mat2 t = u.Transpose();
+            Vec x = t * Vec(1, 0);
+            Vec y = t * Vec(0, 1);
+            aabb->min.Set(WorldVertex(SupportIndex(-x)).x, WorldVertex(SupportIndex(-y)).y);
+            aabb->max.Set(WorldVertex(SupportIndex(x)).x, WorldVertex(SupportIndex(y)).y);
+            return;
+        }
+
+        aabb->min = m_worldVertices[0];
+        aabb->max = m_worldVertices[0];
+        for (int i = 1; i < m_vertexCount; ++i)
+        {
+            const Vec &v = m_worldVertices[i];
+            aabb->min.Set(std::min(aabb->min.x, v.x), std::min(aabb->min.y, v.y));
+            aabb->max.Set(std::max(aabb->max.x, v.x), std::max(aabb->max.y, v.y));
+        }
     }
 
     // Half width and half height
-    void SetBox(double hw, double hh)
+    void SetBox(Real hw, Real hh)
     {
-        m_vertexCount = 4;
+        Reserve(4);
         m_vertices[0].Set(-hw, -hh);
         m_vertices[1].Set(hw, -hh);
         m_vertices[2].Set(hw, hh);
@@ -203,15 +235,14 @@ struct PolygonShape : public Shape
     void Set(Vec *vertices, int count)
     {
         // No hulls with less than 3 vertices (ensure actual polygon)
-        assert(count > 2 && count <= MaxPolyVertexCount);
-        count = std::min((int)count, MaxPolyVertexCount);
+        assert(count > 2);
 
         // Find the right most point on the hull
         int rightMost = 0;
-        double highestXCoord = vertices[0].x;
+        Real highestXCoord = vertices[0].x;
         for (int i = 1; i < count; ++i)
         {
-            double x = vertices[i].x;
+            Real x = vertices[i].x;
             if (x > highestXCoord)
             {
                 highestXCoord = x;
@@ -224,13 +255,13 @@ struct PolygonShape : public Shape
                     rightMost = i;
         }
 
-        int hull[MaxPolyVertexCount];
+        std::vector<int> hull;
         int outCount = 0;
         int indexHull = rightMost;
 
         for (;;)
         {
-            hull[outCount] = indexHull;
+            hull.push_back(indexHull);
 
             // Search for next index that wraps around the hull
             // by computing cross products to find the most counter-clockwise
@@ -252,7 +283,7 @@ struct PolygonShape : public Shape
                 // See : http://www.oocities.org/pcgpe/math2d.html
                 Vec e1 = vertices[nextHullIndex] - vertices[hull[outCount]];
                 Vec e2 = vertices[i] - vertices[hull[outCount]];
-                double c = Cross(e1, e2);
+                Real c = Cross(e1, e2);
                 if (c < 0.0f)
                     nextHullIndex = i;
 
@@ -268,7 +299,7 @@ struct PolygonShape : public Shape
             // Conclude algorithm upon wrap-around
             if (nextHullIndex == rightMost)
             {
-                m_vertexCount = outCount;
+                Reserve(outCount);
                 break;
             }
         }
@@ -290,32 +321,185 @@ struct PolygonShape : public Shape
             m_normals[i1] = Vec(face.y, -face.x);
             m_normals[i1].Normalize();
         }
+
+        BuildSupportKeys();
     }
 
-    // The extreme point along a direction within a polygon
-    Vec GetSupport(const Vec &dir)
+    // Index of the extreme vertex along a direction in model space. Large
+    // hulls binary search their normal angles, vertex i is the support for
+    // every direction between normals i - 1 and i. Any vertex supports a
+    // zero direction.
+    int SupportIndex(const Vec &dir) const
     {
-        double bestProjection = -FLT_MAX;
-        Vec bestVertex;
+        if (m_vertexCount > MaxPolyVertexCount)
+        {
+            if (dir.x == 0 && dir.y == 0)
+                return m_supportStart;
+            int k = std::lower_bound(m_supportKeys.begin(), m_supportKeys.end(), PseudoAngle(dir)) - m_supportKeys.begin();
+            if (k == m_vertexCount)
+                k = 0;
+            k += m_supportStart;
+            return k < m_vertexCount ? k : k - m_vertexCount;
+        }
+
+        Real bestProjection = -FLT_MAX;
+        int bestIndex = 0;
 
         for (int i = 0; i < m_vertexCount; ++i)
         {
-            Vec v = m_vertices[i];
-            double projection = Dot(v, dir);
+            Real projection = Dot(m_vertices[i], dir);
 
             if (projection > bestProjection)
             {
-                bestVertex = v;
+                bestIndex = i;
                 bestProjection = projection;
             }
         }
 
-        return bestVertex;
+        return bestIndex;
+    }
+
+    // The extreme point along a direction within a polygon
+    Vec GetSupport(const Vec &dir) const
+    {
+        return m_vertices[SupportIndex(dir)];
+    }
+
+    // World space vertex and normal i, cached for small polygons and
+    // transformed on demand for large hulls
+    Vec WorldVertex(int i) const
+    {
+        return m_worldVertices ? m_worldVertices[i] : u * m_vertices[i] + body->Position();
+    }
+
+    Vec WorldNormal(int i) const
+    {
+        return m_worldNormals ? m_worldNormals[i] : u * m_normals[i];
+    }
+
+    // SupportIndex for a world space direction, small polygons scan their
+    // cached world vertices instead of rotating dir
+    int WorldSupportIndex(const Vec &dir) const
+    {
+        if (!m_worldVertices)
+            return SupportIndex(u.Transpose() * dir);
+
+        Real bestProjection = -FLT_MAX;
+        int bestIndex = 0;
+        for (int i = 0; i < m_vertexCount; ++i)
+        {
+            Real projection = Dot(m_worldVertices[i], dir);
+            if (projection > bestProjection)
+            {
+                bestIndex = i;
+                bestProjection = projection;
+            }
+        }
+        return bestIndex;
+    }
+
+    // Face whose normal is closest to dir, one of the two around the support vertex
+    int BestFace(const Vec &dir) const
+    {
+        int i = SupportIndex(dir);
+        int prev = i > 0 ? i - 1 : m_vertexCount - 1;
+        return Dot(m_normals[i], dir) >= Dot(m_normals[prev], dir) ? i : prev;
     }
 
     int m_vertexCount;
-    Vec m_vertices[MaxPolyVertexCount];
-    Vec m_normals[MaxPolyVertexCount];
+    Vec *m_vertices; // Counter clockwise, m_localVertices or m_hull
+    Vec *m_normals;
+    Vec *m_worldVertices; // Cached by UpdateGeometry in m_localWorld, NULL for large hulls
+    Vec *m_worldNormals;
+
+private:
+    // Point the vertex and normal arrays at storage for count vertices
+    void Reserve(int count)
+    {
+        m_vertexCount = count;
+        type = count > MaxPolyVertexCount ? eHull : ePoly;
+        if (count <= MaxPolyVertexCount)
+        {
+            std::vector<Vec>().swap(m_hull);
+            m_vertices = m_localVertices;
+            m_normals = m_localNormals;
+            m_worldVertices = m_localWorld;
+            m_worldNormals = m_localWorld + MaxPolyVertexCount;
+        }
+        else
+        {
+            m_hull.resize(2 * count);
+            m_vertices = &m_hull[0];
+            m_normals = &m_hull[count];
+            m_worldVertices = NULL;
+            m_worldNormals = NULL;
+        }
+    }
+
+    // Normal angles in ascending order, starting from m_supportStart
+    void BuildSupportKeys(void)
+    {
+        m_supportKeys.clear();
+        m_supportStart = 0;
+        if (m_vertexCount <= MaxPolyVertexCount)
+            return;
+
+        for (int i = 1; i < m_vertexCount; ++i)
+            if (PseudoAngle(m_normals[i]) < PseudoAngle(m_normals[m_supportStart]))
+                m_supportStart = i;
+
+        for (int k = 0; k < m_vertexCount; ++k)
+            m_supportKeys.push_back(PseudoAngle(m_normals[(m_supportStart + k) % m_vertexCount]));
+    }
+
+    Vec m_localVertices[MaxPolyVertexCount];
+    Vec m_localNormals[MaxPolyVertexCount];
+    Vec m_localWorld[2 * MaxPolyVertexCount]; // World vertices then normals
+    std::vector<Vec> m_hull; // Vertices then normals for large hulls
+    std::vector<Real> m_supportKeys;
+    int m_supportStart;
 };
 
+// Block size for the pools shapes are cloned into
+const int MaxShapeSize = std::max(sizeof(Circle), sizeof(PolygonShape));
+
+inline Shape *Shape::Clone(void *memory) const
+{
+    if (type == eCircle)
+        return new (memory) Circle(radius);
+    return new (memory) PolygonShape(*static_cast<const PolygonShape *>(this));
+}
+
+inline void Shape::Destroy(void)
+{
+    if (type == eCircle)
+        static_cast<Circle *>(this)->~Circle();
+    else
+        static_cast<PolygonShape *>(this)->~PolygonShape();
+}
+
+inline void Shape::ComputeMass(Real density)
+{
+    if (type == eCircle)
+        static_cast<Circle *>(this)->ComputeMass(density);
+    else
+        static_cast<PolygonShape *>(this)->ComputeMass(density);
+}
+
+inline void Shape::UpdateGeometry(void)
+{
+    if (type == eCircle)
+        static_cast<Circle *>(this)->UpdateGeometry();
+    else
+        static_cast<PolygonShape *>(this)->UpdateGeometry();
+}
+
+inline void Shape::ComputeAABB(AABB *aabb) const
+{
+    if (type == eCircle)
+        static_cast<const Circle *>(this)->ComputeAABB(aabb);
+    else
+        static_cast<const PolygonShape *>(this)->ComputeAABB(aabb);
+}
+
 #endif // SHAPE_H